@@ -0,0 +1,595 @@
+#ifndef BUCKETRBTREE_HPP
+#define BUCKETRBTREE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "RBTree.hpp"
+
+// A red-black tree of buckets. Every node holds up to BUCKET_SIZE elements
+// in a sorted array, and all elements in its left (right) subtree are
+// smaller (larger) than the whole array. A full bucket splits in two; a
+// bucket that drops below a quarter full is merged into a neighbour.
+// Lookups touch one node per few cache lines instead of one per element,
+// and in-order scans read each bucket sequentially.
+template <typename T, std::size_t BUCKET_SIZE = 16>
+class BucketRBTree {
+  static_assert(BUCKET_SIZE >= 4, "buckets need room to split and merge");
+
+ private:
+  struct Node {
+    Node* parent = nullptr;
+    Node* leftChild = nullptr;
+    Node* rightChild = nullptr;
+    Colour colour = Colour::RED;
+    std::size_t count = 0;
+    T elements[BUCKET_SIZE];
+
+    T* begin() { return elements; }
+    T* end() { return elements + count; }
+    const T& front() { return elements[0]; }
+    const T& back() { return elements[count - 1]; }
+  };
+
+  // A merge may not produce a bucket fuller than this, so that it does not
+  // split again on the next insert.
+  static constexpr std::size_t MERGE_LIMIT = BUCKET_SIZE * 3 / 4;
+
+  Node* root = nullptr;
+  Node* nilNode = nullptr;
+  std::size_t nodeCount = 0;
+  std::size_t bucketTotal = 0;
+  // Number of black buckets on every path from root down to nil.
+  int blackHeight = 0;
+
+  void Left_Rotate(Node* x);
+  void Right_Rotate(Node* x);
+  void RB_Insert_Fixup(Node* node);
+  void RB_Transplant(Node* node, Node* nodechild);
+  void RB_Delete_Fixup(Node* node);
+  Node* newBucket();
+  void insertAfter(Node* bucket, Node* newNode);
+  void removeBucket(Node* bucket);
+  Node* splitBucket(Node* bucket);
+  void mergeUnderfull(Node* bucket);
+  Node* findBucket(const T& element);
+  Node* treeMinimum(Node* node);
+  Node* treeMaximum(Node* node);
+  Node* successor(Node* node);
+  Node* predecessor(Node* node);
+  int heightRec(Node* node);
+
+ public:
+  static constexpr std::size_t NODE_BYTES = sizeof(Node);
+
+  BucketRBTree();
+  ~BucketRBTree();
+
+  BucketRBTree(const BucketRBTree& other) = delete;
+  BucketRBTree& operator=(const BucketRBTree& other) = delete;
+
+  bool addNode(const T& element);
+  bool deleteNode(const T& element);
+  bool find(const T& element);
+  const T& min();
+  const T& max();
+  std::size_t size();
+  // Number of buckets, i.e. nodes in the red-black tree.
+  std::size_t bucketCount();
+  std::vector<T> inOrder();
+  // Calls fn on every element in ascending order. fn may return bool, in
+  // which case returning false stops the traversal early.
+  template <typename F>
+  bool forEach(F fn);
+  // Height of the tree of buckets, counted in edges like RBTree::height().
+  int height();
+  std::pair<int, int> heightBounds();
+};
+
+template <typename T, std::size_t BUCKET_SIZE>
+BucketRBTree<T, BUCKET_SIZE>::BucketRBTree() {
+  nilNode = new Node;
+  nilNode->colour = Colour::BLACK;
+  root = nilNode;
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+BucketRBTree<T, BUCKET_SIZE>::~BucketRBTree() {
+  Node* curr = root;
+  while (curr != nilNode) {
+    if (curr->leftChild != nilNode) {
+      curr = curr->leftChild;
+    } else if (curr->rightChild != nilNode) {
+      curr = curr->rightChild;
+    } else {
+      Node* parentNode = curr->parent;
+      if (parentNode != nilNode) {
+        if (curr == parentNode->leftChild) {
+          parentNode->leftChild = nilNode;
+        } else {
+          parentNode->rightChild = nilNode;
+        }
+      }
+      delete curr;
+      curr = parentNode;
+    }
+  }
+  delete nilNode;
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+void BucketRBTree<T, BUCKET_SIZE>::Left_Rotate(Node* x) {
+  Node* y = x->rightChild;
+  x->rightChild = y->leftChild;
+  if (y->leftChild != nilNode) {
+    y->leftChild->parent = x;
+  }
+  y->parent = x->parent;
+  if (x->parent == nilNode) {
+    root = y;
+  } else if (x == x->parent->leftChild) {
+    x->parent->leftChild = y;
+  } else {
+    x->parent->rightChild = y;
+  }
+  y->leftChild = x;
+  x->parent = y;
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+void BucketRBTree<T, BUCKET_SIZE>::Right_Rotate(Node* x) {
+  Node* y = x->leftChild;
+  x->leftChild = y->rightChild;
+  if (y->rightChild != nilNode) {
+    y->rightChild->parent = x;
+  }
+  y->parent = x->parent;
+  if (x->parent == nilNode) {
+    root = y;
+  } else if (x == x->parent->rightChild) {
+    x->parent->rightChild = y;
+  } else {
+    x->parent->leftChild = y;
+  }
+  y->rightChild = x;
+  x->parent = y;
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+void BucketRBTree<T, BUCKET_SIZE>::RB_Insert_Fixup(Node* node) {
+  while (node->parent->colour == Colour::RED) {
+    Node* grandparent = node->parent->parent;
+    if (node->parent == grandparent->rightChild) {
+      Node* uncle = grandparent->leftChild;
+      if (uncle->colour == Colour::RED) {
+        node->parent->colour = Colour::BLACK;
+        uncle->colour = Colour::BLACK;
+        grandparent->colour = Colour::RED;
+        node = grandparent;
+      } else {
+        if (node == node->parent->leftChild) {
+          node = node->parent;
+          Right_Rotate(node);
+        }
+        node->parent->colour = Colour::BLACK;
+        grandparent->colour = Colour::RED;
+        Left_Rotate(grandparent);
+      }
+    } else {
+      Node* uncle = grandparent->rightChild;
+      if (uncle->colour == Colour::RED) {
+        node->parent->colour = Colour::BLACK;
+        uncle->colour = Colour::BLACK;
+        grandparent->colour = Colour::RED;
+        node = grandparent;
+      } else {
+        if (node == node->parent->rightChild) {
+          node = node->parent;
+          Left_Rotate(node);
+        }
+        node->parent->colour = Colour::BLACK;
+        grandparent->colour = Colour::RED;
+        Right_Rotate(grandparent);
+      }
+    }
+  }
+  if (root->colour == Colour::RED) {
+    ++blackHeight;
+  }
+  root->colour = Colour::BLACK;
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+void BucketRBTree<T, BUCKET_SIZE>::RB_Transplant(Node* node,
+                                                 Node* nodechild) {
+  if (node->parent == nilNode) {
+    root = nodechild;
+  } else if (node == node->parent->leftChild) {
+    node->parent->leftChild = nodechild;
+  } else {
+    node->parent->rightChild = nodechild;
+  }
+  nodechild->parent = node->parent;
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+void BucketRBTree<T, BUCKET_SIZE>::RB_Delete_Fixup(Node* node) {
+  while (node != root && node->colour == Colour::BLACK) {
+    Node* parentNode = node->parent;
+    if (node == parentNode->leftChild) {
+      Node* sibling = parentNode->rightChild;
+      if (sibling->colour == Colour::RED) {
+        sibling->colour = Colour::BLACK;
+        parentNode->colour = Colour::RED;
+        Left_Rotate(parentNode);
+        sibling = parentNode->rightChild;
+      }
+      if (sibling->leftChild->colour == Colour::BLACK &&
+          sibling->rightChild->colour == Colour::BLACK) {
+        sibling->colour = Colour::RED;
+        node = parentNode;
+        if (node == root && node->colour == Colour::BLACK) {
+          --blackHeight;
+        }
+      } else {
+        if (sibling->rightChild->colour == Colour::BLACK) {
+          sibling->leftChild->colour = Colour::BLACK;
+          sibling->colour = Colour::RED;
+          Right_Rotate(sibling);
+          sibling = parentNode->rightChild;
+        }
+        sibling->colour = parentNode->colour;
+        parentNode->colour = Colour::BLACK;
+        sibling->rightChild->colour = Colour::BLACK;
+        Left_Rotate(parentNode);
+        node = root;
+      }
+    } else {
+      Node* sibling = parentNode->leftChild;
+      if (sibling->colour == Colour::RED) {
+        sibling->colour = Colour::BLACK;
+        parentNode->colour = Colour::RED;
+        Right_Rotate(parentNode);
+        sibling = parentNode->leftChild;
+      }
+      if (sibling->leftChild->colour == Colour::BLACK &&
+          sibling->rightChild->colour == Colour::BLACK) {
+        sibling->colour = Colour::RED;
+        node = parentNode;
+        if (node == root && node->colour == Colour::BLACK) {
+          --blackHeight;
+        }
+      } else {
+        if (sibling->leftChild->colour == Colour::BLACK) {
+          sibling->rightChild->colour = Colour::BLACK;
+          sibling->colour = Colour::RED;
+          Left_Rotate(sibling);
+          sibling = parentNode->leftChild;
+        }
+        sibling->colour = parentNode->colour;
+        parentNode->colour = Colour::BLACK;
+        sibling->leftChild->colour = Colour::BLACK;
+        Right_Rotate(parentNode);
+        node = root;
+      }
+    }
+  }
+  node->colour = Colour::BLACK;
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+typename BucketRBTree<T, BUCKET_SIZE>::Node*
+BucketRBTree<T, BUCKET_SIZE>::newBucket() {
+  Node* bucket = new Node;
+  bucket->parent = nilNode;
+  bucket->leftChild = nilNode;
+  bucket->rightChild = nilNode;
+  ++bucketTotal;
+  return bucket;
+}
+
+// Links newNode into the tree as the in-order successor of bucket.
+template <typename T, std::size_t BUCKET_SIZE>
+void BucketRBTree<T, BUCKET_SIZE>::insertAfter(Node* bucket, Node* newNode) {
+  if (bucket->rightChild == nilNode) {
+    bucket->rightChild = newNode;
+    newNode->parent = bucket;
+  } else {
+    Node* leftmost = treeMinimum(bucket->rightChild);
+    leftmost->leftChild = newNode;
+    newNode->parent = leftmost;
+  }
+  RB_Insert_Fixup(newNode);
+}
+
+// Unlinks bucket from the tree and frees it.
+template <typename T, std::size_t BUCKET_SIZE>
+void BucketRBTree<T, BUCKET_SIZE>::removeBucket(Node* bucket) {
+  Node* y = bucket;
+  Node* x = nullptr;
+  Colour yOriginalColour = y->colour;
+  if (bucket->leftChild == nilNode) {
+    x = bucket->rightChild;
+    RB_Transplant(bucket, x);
+  } else if (bucket->rightChild == nilNode) {
+    x = bucket->leftChild;
+    RB_Transplant(bucket, x);
+  } else {
+    y = treeMinimum(bucket->rightChild);
+    yOriginalColour = y->colour;
+    x = y->rightChild;
+    if (y->parent == bucket) {
+      x->parent = y;
+    } else {
+      RB_Transplant(y, x);
+      y->rightChild = bucket->rightChild;
+      y->rightChild->parent = y;
+    }
+    RB_Transplant(bucket, y);
+    y->leftChild = bucket->leftChild;
+    y->leftChild->parent = y;
+    y->colour = bucket->colour;
+  }
+  delete bucket;
+  --bucketTotal;
+  if (yOriginalColour == Colour::BLACK) {
+    RB_Delete_Fixup(x);
+  }
+  if (root == nilNode) {
+    blackHeight = 0;
+  }
+}
+
+// Moves the upper half of a full bucket into a new bucket right after it.
+template <typename T, std::size_t BUCKET_SIZE>
+typename BucketRBTree<T, BUCKET_SIZE>::Node*
+BucketRBTree<T, BUCKET_SIZE>::splitBucket(Node* bucket) {
+  Node* upper = newBucket();
+  std::size_t half = bucket->count / 2;
+  std::move(bucket->begin() + half, bucket->end(), upper->elements);
+  upper->count = bucket->count - half;
+  std::fill(bucket->begin() + half, bucket->end(), T());
+  bucket->count = half;
+  insertAfter(bucket, upper);
+  return upper;
+}
+
+// Folds an underfull bucket together with its successor or predecessor
+// when the result stays below MERGE_LIMIT.
+template <typename T, std::size_t BUCKET_SIZE>
+void BucketRBTree<T, BUCKET_SIZE>::mergeUnderfull(Node* bucket) {
+  Node* next = successor(bucket);
+  if (next != nilNode && bucket->count + next->count <= MERGE_LIMIT) {
+    std::move(next->begin(), next->end(), bucket->end());
+    bucket->count += next->count;
+    removeBucket(next);
+    return;
+  }
+  Node* previous = predecessor(bucket);
+  if (previous != nilNode &&
+      previous->count + bucket->count <= MERGE_LIMIT) {
+    std::move(bucket->begin(), bucket->end(), previous->end());
+    previous->count += bucket->count;
+    removeBucket(bucket);
+  }
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+bool BucketRBTree<T, BUCKET_SIZE>::addNode(const T& element) {
+  if (root == nilNode) {
+    root = newBucket();
+    root->colour = Colour::BLACK;
+    root->elements[0] = element;
+    root->count = 1;
+    blackHeight = 1;
+    ++nodeCount;
+    return true;
+  }
+  // Stop at the bucket whose range holds element, or at the last bucket on
+  // the path; element then lies in the gap next to that bucket.
+  Node* bucket = root;
+  Node* curr = root;
+  while (curr != nilNode) {
+    bucket = curr;
+    if (element < curr->front()) {
+      curr = curr->leftChild;
+    } else if (curr->back() < element) {
+      curr = curr->rightChild;
+    } else {
+      break;
+    }
+  }
+  T* pos = std::lower_bound(bucket->begin(), bucket->end(), element);
+  if (pos != bucket->end() && !(element < *pos)) {
+    return false;
+  }
+  if (bucket->count == BUCKET_SIZE) {
+    Node* upper = splitBucket(bucket);
+    if (!(element < upper->front())) {
+      bucket = upper;
+    }
+    pos = std::lower_bound(bucket->begin(), bucket->end(), element);
+  }
+  std::move_backward(pos, bucket->end(), bucket->end() + 1);
+  *pos = element;
+  ++bucket->count;
+  ++nodeCount;
+  return true;
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+typename BucketRBTree<T, BUCKET_SIZE>::Node*
+BucketRBTree<T, BUCKET_SIZE>::findBucket(const T& element) {
+  Node* curr = root;
+  while (curr != nilNode) {
+    if (element < curr->front()) {
+      curr = curr->leftChild;
+    } else if (curr->back() < element) {
+      curr = curr->rightChild;
+    } else {
+      return curr;
+    }
+  }
+  return nilNode;
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+bool BucketRBTree<T, BUCKET_SIZE>::deleteNode(const T& element) {
+  Node* bucket = findBucket(element);
+  if (bucket == nilNode) {
+    return false;
+  }
+  T* pos = std::lower_bound(bucket->begin(), bucket->end(), element);
+  if (pos == bucket->end() || element < *pos) {
+    return false;
+  }
+  std::move(pos + 1, bucket->end(), pos);
+  --bucket->count;
+  bucket->elements[bucket->count] = T();
+  --nodeCount;
+  if (bucket->count == 0) {
+    removeBucket(bucket);
+  } else if (bucket->count < BUCKET_SIZE / 4) {
+    mergeUnderfull(bucket);
+  }
+  return true;
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+bool BucketRBTree<T, BUCKET_SIZE>::find(const T& element) {
+  Node* bucket = findBucket(element);
+  return bucket != nilNode &&
+         std::binary_search(bucket->begin(), bucket->end(), element);
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+typename BucketRBTree<T, BUCKET_SIZE>::Node*
+BucketRBTree<T, BUCKET_SIZE>::treeMinimum(Node* node) {
+  if (node == nilNode) {
+    return nilNode;
+  }
+  while (node->leftChild != nilNode) {
+    node = node->leftChild;
+  }
+  return node;
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+typename BucketRBTree<T, BUCKET_SIZE>::Node*
+BucketRBTree<T, BUCKET_SIZE>::treeMaximum(Node* node) {
+  if (node == nilNode) {
+    return nilNode;
+  }
+  while (node->rightChild != nilNode) {
+    node = node->rightChild;
+  }
+  return node;
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+typename BucketRBTree<T, BUCKET_SIZE>::Node*
+BucketRBTree<T, BUCKET_SIZE>::successor(Node* node) {
+  if (node->rightChild != nilNode) {
+    return treeMinimum(node->rightChild);
+  }
+  Node* parentNode = node->parent;
+  while (parentNode != nilNode && node == parentNode->rightChild) {
+    node = parentNode;
+    parentNode = parentNode->parent;
+  }
+  return parentNode;
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+typename BucketRBTree<T, BUCKET_SIZE>::Node*
+BucketRBTree<T, BUCKET_SIZE>::predecessor(Node* node) {
+  if (node->leftChild != nilNode) {
+    return treeMaximum(node->leftChild);
+  }
+  Node* parentNode = node->parent;
+  while (parentNode != nilNode && node == parentNode->leftChild) {
+    node = parentNode;
+    parentNode = parentNode->parent;
+  }
+  return parentNode;
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+const T& BucketRBTree<T, BUCKET_SIZE>::min() {
+  if (root == nilNode) {
+    throw std::string("The tree is empty");
+  }
+  return treeMinimum(root)->front();
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+const T& BucketRBTree<T, BUCKET_SIZE>::max() {
+  if (root == nilNode) {
+    throw std::string("The tree is empty");
+  }
+  return treeMaximum(root)->back();
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+std::size_t BucketRBTree<T, BUCKET_SIZE>::size() {
+  return nodeCount;
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+std::size_t BucketRBTree<T, BUCKET_SIZE>::bucketCount() {
+  return bucketTotal;
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+template <typename F>
+bool BucketRBTree<T, BUCKET_SIZE>::forEach(F fn) {
+  for (Node* bucket = treeMinimum(root); bucket != nilNode;
+       bucket = successor(bucket)) {
+    for (const T& element : *bucket) {
+      if constexpr (std::is_void_v<std::invoke_result_t<F&, const T&>>) {
+        fn(element);
+      } else if (!fn(element)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+std::vector<T> BucketRBTree<T, BUCKET_SIZE>::inOrder() {
+  std::vector<T> order;
+  order.reserve(nodeCount);
+  for (Node* bucket = treeMinimum(root); bucket != nilNode;
+       bucket = successor(bucket)) {
+    order.insert(order.end(), bucket->begin(), bucket->end());
+  }
+  return order;
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+int BucketRBTree<T, BUCKET_SIZE>::heightRec(Node* node) {
+  if (node == nilNode) {
+    return -1;
+  }
+  return 1 + std::max(heightRec(node->leftChild), heightRec(node->rightChild));
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+int BucketRBTree<T, BUCKET_SIZE>::height() {
+  return heightRec(root);
+}
+
+template <typename T, std::size_t BUCKET_SIZE>
+std::pair<int, int> BucketRBTree<T, BUCKET_SIZE>::heightBounds() {
+  if (root == nilNode) {
+    return {-1, -1};
+  }
+  return {blackHeight - 1, 2 * blackHeight - 1};
+}
+
+#endif
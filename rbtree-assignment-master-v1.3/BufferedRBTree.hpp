@@ -0,0 +1,137 @@
+#ifndef BUFFEREDRBTREE_HPP
+#define BUFFEREDRBTREE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "FrozenRBTree.hpp"
+#include "RBTree.hpp"
+
+// A set for write bursts. Changes go into a small buffer: inserts into one
+// RBTree, deletes of elements in the base into another as tombstones.
+// Lookups check the buffer and then a FrozenRBTree base. compact() merges
+// buffer and base into a new base in one linear pass. It also runs
+// automatically once the buffer holds more than bufferLimit entries or an
+// eighth of the base, whichever is larger, so merging costs a constant
+// amount per write.
+template <typename T>
+class BufferedRBTree {
+ private:
+  FrozenRBTree<T> base;
+  RBTree<T> inserted;
+  // Elements of base that have been deleted.
+  RBTree<T> tombstones;
+  std::size_t bufferLimit;
+
+  std::vector<T> merged();
+  void compactIfFull();
+
+ public:
+  explicit BufferedRBTree(std::size_t bufferLimit = 1024);
+
+  BufferedRBTree(const BufferedRBTree& other) = delete;
+  BufferedRBTree& operator=(const BufferedRBTree& other) = delete;
+
+  bool addNode(const T& element);
+  bool deleteNode(const T& element);
+  bool find(const T& element);
+  std::size_t size();
+  // Inserts and tombstones waiting to be merged into the base.
+  std::size_t bufferSize();
+  std::vector<T> inOrder();
+  void compact();
+};
+
+template <typename T>
+BufferedRBTree<T>::BufferedRBTree(std::size_t bufferLimit)
+    : bufferLimit(bufferLimit) {}
+
+template <typename T>
+bool BufferedRBTree<T>::addNode(const T& element) {
+  if (tombstones.deleteNode(element)) {
+    return true;
+  }
+  if (base.find(element) || !inserted.addNode(element)) {
+    return false;
+  }
+  compactIfFull();
+  return true;
+}
+
+template <typename T>
+bool BufferedRBTree<T>::deleteNode(const T& element) {
+  if (inserted.deleteNode(element)) {
+    return true;
+  }
+  if (!base.find(element) || !tombstones.addNode(element)) {
+    return false;
+  }
+  compactIfFull();
+  return true;
+}
+
+template <typename T>
+bool BufferedRBTree<T>::find(const T& element) {
+  return inserted.find(element) ||
+         (base.find(element) && !tombstones.find(element));
+}
+
+template <typename T>
+std::size_t BufferedRBTree<T>::size() {
+  return base.size() + inserted.size() - tombstones.size();
+}
+
+template <typename T>
+std::size_t BufferedRBTree<T>::bufferSize() {
+  return inserted.size() + tombstones.size();
+}
+
+// The elements in order: base without the tombstones, merged with the
+// inserts. Inserts are never in base, so the two never hold the same
+// element.
+template <typename T>
+std::vector<T> BufferedRBTree<T>::merged() {
+  std::vector<T> added = inserted.inOrder();
+  std::vector<T> removed = tombstones.inOrder();
+  std::vector<T> result;
+  result.reserve(size());
+  auto nextAdded = added.begin();
+  auto nextRemoved = removed.begin();
+  base.forEach([&](const T& element) {
+    while (nextAdded != added.end() && *nextAdded < element) {
+      result.push_back(*nextAdded++);
+    }
+    if (nextRemoved != removed.end() && !(element < *nextRemoved)) {
+      ++nextRemoved;
+    } else {
+      result.push_back(element);
+    }
+  });
+  result.insert(result.end(), nextAdded, added.end());
+  return result;
+}
+
+template <typename T>
+std::vector<T> BufferedRBTree<T>::inOrder() {
+  return merged();
+}
+
+template <typename T>
+void BufferedRBTree<T>::compact() {
+  if (bufferSize() == 0) {
+    return;
+  }
+  base = FrozenRBTree<T>(merged());
+  inserted.clear();
+  tombstones.clear();
+}
+
+template <typename T>
+void BufferedRBTree<T>::compactIfFull() {
+  if (bufferSize() > std::max(bufferLimit, base.size() / 8)) {
+    compact();
+  }
+}
+
+#endif
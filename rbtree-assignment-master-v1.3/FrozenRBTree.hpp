@@ -0,0 +1,209 @@
+#ifndef FROZENRBTREE_HPP
+#define FROZENRBTREE_HPP
+
+#include <cstddef>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if !defined(__GNUC__) && (defined(_M_IX86) || defined(_M_X64))
+#include <xmmintrin.h>
+#endif
+
+// Allocates on cache line boundaries, or stricter ones if T needs them.
+template <typename T>
+struct CacheLineAllocator {
+  static constexpr std::size_t ALIGNMENT = alignof(T) > 64 ? alignof(T) : 64;
+  using value_type = T;
+
+  CacheLineAllocator() = default;
+  template <typename U>
+  CacheLineAllocator(const CacheLineAllocator<U>&) {}
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(
+        ::operator new(n * sizeof(T), std::align_val_t(ALIGNMENT)));
+  }
+  void deallocate(T* p, std::size_t) {
+    ::operator delete(p, std::align_val_t(ALIGNMENT));
+  }
+  template <typename U>
+  bool operator==(const CacheLineAllocator<U>&) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const CacheLineAllocator<U>&) const {
+    return false;
+  }
+};
+
+// An immutable sorted set built from RBTree::freeze(). The elements are
+// stored in one array in Eytzinger (breadth-first) order: the children of
+// slot k are slots 2k and 2k + 1, and slot 0 is unused. A lookup walks down
+// the implicit tree without branching on the comparison, and prefetches
+// the descendants four levels below while it works on the levels above.
+// The array starts on a cache line, so when sizeof(T) is a power of two
+// those descendants share one line (all 16 of them for 4-byte keys).
+template <typename T>
+class FrozenRBTree {
+ private:
+  std::vector<T, CacheLineAllocator<T>> slots;
+  // Slots per cache line, rounded down to a power of two.
+  static constexpr std::size_t LINE_SLOTS =
+      sizeof(T) >= 64   ? 1
+      : sizeof(T) > 16  ? 2
+      : sizeof(T) > 8   ? 4
+      : sizeof(T) > 4   ? 8
+      : sizeof(T) > 2   ? 16
+      : sizeof(T) > 1   ? 32
+                        : 64;
+
+  std::size_t fill(const std::vector<T>& sorted, std::size_t next,
+                   std::size_t k);
+  std::size_t lowerBoundSlot(const T& element) const;
+  static void prefetchSlot(const T* slot);
+
+ public:
+  FrozenRBTree() = default;
+  // sorted must be in strictly ascending order.
+  explicit FrozenRBTree(const std::vector<T>& sorted);
+
+  bool find(const T& element) const;
+  const T& min() const;
+  const T& max() const;
+  std::size_t size() const;
+  std::vector<T> inOrder() const;
+  // Calls fn on every element in ascending order. fn may return bool, in
+  // which case returning false stops the traversal early.
+  template <typename F>
+  bool forEach(F fn) const;
+};
+
+template <typename T>
+FrozenRBTree<T>::FrozenRBTree(const std::vector<T>& sorted)
+    : slots(sorted.size() + 1) {
+  fill(sorted, 0, 1);
+}
+
+// Writes sorted[next...] into the subtree rooted at slot k in order, and
+// returns the index of the first element not written.
+template <typename T>
+std::size_t FrozenRBTree<T>::fill(const std::vector<T>& sorted,
+                                  std::size_t next, std::size_t k) {
+  if (k < slots.size()) {
+    next = fill(sorted, next, 2 * k);
+    slots[k] = sorted[next++];
+    next = fill(sorted, next, 2 * k + 1);
+  }
+  return next;
+}
+
+template <typename T>
+void FrozenRBTree<T>::prefetchSlot(const T* slot) {
+#if defined(__GNUC__)
+  __builtin_prefetch(slot);
+#elif defined(_M_IX86) || defined(_M_X64)
+  _mm_prefetch(reinterpret_cast<const char*>(slot), _MM_HINT_T0);
+#endif
+}
+
+// Slot of the smallest element not less than element, or 0 if there is
+// none.
+template <typename T>
+std::size_t FrozenRBTree<T>::lowerBoundSlot(const T& element) const {
+  const std::size_t n = slots.size();
+  const T* base = slots.data();
+  std::size_t k = 1;
+  while (k < n) {
+    std::size_t ahead = k * LINE_SLOTS;
+    prefetchSlot(base + (ahead < n ? ahead : 0));
+    k = 2 * k + static_cast<std::size_t>(base[k] < element);
+  }
+  // Each step right appended a 1 bit; undo those and the last step left to
+  // reach the last slot where the descent went left.
+  while (k & 1) {
+    k >>= 1;
+  }
+  return k >> 1;
+}
+
+template <typename T>
+bool FrozenRBTree<T>::find(const T& element) const {
+  std::size_t k = lowerBoundSlot(element);
+  return k != 0 && !(element < slots[k]);
+}
+
+template <typename T>
+const T& FrozenRBTree<T>::min() const {
+  if (size() == 0) {
+    throw std::string("The tree is empty");
+  }
+  std::size_t k = 1;
+  while (2 * k < slots.size()) {
+    k = 2 * k;
+  }
+  return slots[k];
+}
+
+template <typename T>
+const T& FrozenRBTree<T>::max() const {
+  if (size() == 0) {
+    throw std::string("The tree is empty");
+  }
+  std::size_t k = 1;
+  while (2 * k + 1 < slots.size()) {
+    k = 2 * k + 1;
+  }
+  return slots[k];
+}
+
+template <typename T>
+std::size_t FrozenRBTree<T>::size() const {
+  return slots.empty() ? 0 : slots.size() - 1;
+}
+
+template <typename T>
+template <typename F>
+bool FrozenRBTree<T>::forEach(F fn) const {
+  // In-order walk of the implicit tree: go left as far as possible, then
+  // after visiting k continue with the leftmost slot of its right subtree,
+  // or climb while coming from a right child.
+  const std::size_t n = slots.size();
+  std::size_t k = 1;
+  if (k >= n) {
+    return true;
+  }
+  while (2 * k < n) {
+    k = 2 * k;
+  }
+  while (k != 0) {
+    if constexpr (std::is_void_v<std::invoke_result_t<F&, const T&>>) {
+      fn(slots[k]);
+    } else if (!fn(slots[k])) {
+      return false;
+    }
+    if (2 * k + 1 < n) {
+      k = 2 * k + 1;
+      while (2 * k < n) {
+        k = 2 * k;
+      }
+    } else {
+      while (k & 1) {
+        k >>= 1;
+      }
+      k >>= 1;
+    }
+  }
+  return true;
+}
+
+template <typename T>
+std::vector<T> FrozenRBTree<T>::inOrder() const {
+  std::vector<T> order;
+  order.reserve(size());
+  forEach([&](const T& element) { order.push_back(element); });
+  return order;
+}
+
+#endif
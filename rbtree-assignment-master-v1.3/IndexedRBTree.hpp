@@ -0,0 +1,564 @@
+#ifndef INDEXEDRBTREE_HPP
+#define INDEXEDRBTREE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "RBTree.hpp"
+
+// A red-black tree whose nodes live in one contiguous std::vector and link
+// to each other through 32-bit indices instead of pointers. Slot 0 is the
+// nil sentinel. Since no link depends on where the vector is, the tree can
+// be copied, moved or snapshotted with a single memcpy.
+template <typename T>
+class IndexedRBTree {
+ public:
+  using Index = std::uint32_t;
+
+ private:
+  struct Node {
+    Index parent = 0;
+    Index leftChild = 0;
+    Index rightChild = 0;
+    Colour colour = Colour::RED;
+    T element = T();
+  };
+
+  // Written in front of the nodes by snapshot().
+  struct SnapshotHeader {
+    std::uint64_t slots;
+    std::uint64_t nodeCount;
+    Index root;
+    Index freeList;
+    std::int32_t blackHeight;
+  };
+
+  static constexpr Index NIL = 0;
+
+  std::vector<Node> nodes;
+  Index root = NIL;
+  // Slots released by deleteNode, chained through leftChild.
+  Index freeList = NIL;
+  std::size_t nodeCount = 0;
+  // Number of black nodes on every path from root down to nil (nil excluded).
+  int blackHeight = 0;
+
+  Index allocateNode(const T& element);
+  void freeNode(Index node);
+  void Left_Rotate(Index x);
+  void Right_Rotate(Index x);
+  void RB_Insert_Fixup(Index node);
+  void RB_Transplant(Index node, Index nodechild);
+  void RB_Delete_Fixup(Index node);
+  Index findNode(const T& element);
+  Index treeMinimum(Index node);
+  Index treeMaximum(Index node);
+  Index successor(Index node);
+  int heightRec(Index node);
+
+ public:
+  // Bytes taken by one node slot.
+  static constexpr std::size_t NODE_BYTES = sizeof(Node);
+
+  IndexedRBTree();
+
+  bool addNode(const T& element);
+  bool deleteNode(const T& element);
+  bool find(const T& element);
+  const T& min();
+  const T& max();
+  std::size_t size();
+  std::vector<T> inOrder();
+  // Calls fn on every element in ascending order. fn may return bool, in
+  // which case returning false stops the traversal early.
+  template <typename F>
+  bool forEach(F fn);
+  int height();
+  std::pair<int, int> heightBounds();
+  std::vector<T> pathFromRoot(const T& element);
+  void clear();
+  // Replaces the contents of out with a byte image of the tree. Requires a
+  // trivially copyable T.
+  void snapshot(std::vector<unsigned char>& out);
+  // Replaces the tree with an image written by snapshot(). Throws
+  // std::invalid_argument, leaving the tree as it was, if bytes does not
+  // match the size in the image's header or a link in it points past the
+  // slots it holds.
+  void restore(const unsigned char* data, std::size_t bytes);
+};
+
+template <typename T>
+IndexedRBTree<T>::IndexedRBTree() {
+  nodes.emplace_back();
+  nodes[NIL].colour = Colour::BLACK;
+}
+
+template <typename T>
+typename IndexedRBTree<T>::Index IndexedRBTree<T>::allocateNode(
+    const T& element) {
+  Index node = freeList;
+  if (node != NIL) {
+    freeList = nodes[node].leftChild;
+    nodes[node] = Node();
+  } else {
+    if (nodes.size() > std::numeric_limits<Index>::max()) {
+      throw std::string("The tree is full");
+    }
+    node = static_cast<Index>(nodes.size());
+    nodes.emplace_back();
+  }
+  nodes[node].element = element;
+  return node;
+}
+
+template <typename T>
+void IndexedRBTree<T>::freeNode(Index node) {
+  nodes[node] = Node();
+  nodes[node].leftChild = freeList;
+  freeList = node;
+}
+
+template <typename T>
+void IndexedRBTree<T>::Left_Rotate(Index x) {
+  Index y = nodes[x].rightChild;
+  nodes[x].rightChild = nodes[y].leftChild;
+  if (nodes[y].leftChild != NIL) {
+    nodes[nodes[y].leftChild].parent = x;
+  }
+  nodes[y].parent = nodes[x].parent;
+  if (nodes[x].parent == NIL) {
+    root = y;
+  } else if (x == nodes[nodes[x].parent].leftChild) {
+    nodes[nodes[x].parent].leftChild = y;
+  } else {
+    nodes[nodes[x].parent].rightChild = y;
+  }
+  nodes[y].leftChild = x;
+  nodes[x].parent = y;
+}
+
+template <typename T>
+void IndexedRBTree<T>::Right_Rotate(Index x) {
+  Index y = nodes[x].leftChild;
+  nodes[x].leftChild = nodes[y].rightChild;
+  if (nodes[y].rightChild != NIL) {
+    nodes[nodes[y].rightChild].parent = x;
+  }
+  nodes[y].parent = nodes[x].parent;
+  if (nodes[x].parent == NIL) {
+    root = y;
+  } else if (x == nodes[nodes[x].parent].rightChild) {
+    nodes[nodes[x].parent].rightChild = y;
+  } else {
+    nodes[nodes[x].parent].leftChild = y;
+  }
+  nodes[y].rightChild = x;
+  nodes[x].parent = y;
+}
+
+template <typename T>
+void IndexedRBTree<T>::RB_Insert_Fixup(Index node) {
+  while (nodes[nodes[node].parent].colour == Colour::RED) {
+    Index parentNode = nodes[node].parent;
+    Index grandparent = nodes[parentNode].parent;
+    if (parentNode == nodes[grandparent].rightChild) {
+      Index uncle = nodes[grandparent].leftChild;
+      if (nodes[uncle].colour == Colour::RED) {
+        nodes[parentNode].colour = Colour::BLACK;
+        nodes[uncle].colour = Colour::BLACK;
+        nodes[grandparent].colour = Colour::RED;
+        node = grandparent;
+      } else {
+        if (node == nodes[parentNode].leftChild) {
+          node = parentNode;
+          Right_Rotate(node);
+        }
+        nodes[nodes[node].parent].colour = Colour::BLACK;
+        nodes[grandparent].colour = Colour::RED;
+        Left_Rotate(grandparent);
+      }
+    } else {
+      Index uncle = nodes[grandparent].rightChild;
+      if (nodes[uncle].colour == Colour::RED) {
+        nodes[parentNode].colour = Colour::BLACK;
+        nodes[uncle].colour = Colour::BLACK;
+        nodes[grandparent].colour = Colour::RED;
+        node = grandparent;
+      } else {
+        if (node == nodes[parentNode].rightChild) {
+          node = parentNode;
+          Left_Rotate(node);
+        }
+        nodes[nodes[node].parent].colour = Colour::BLACK;
+        nodes[grandparent].colour = Colour::RED;
+        Right_Rotate(grandparent);
+      }
+    }
+  }
+  if (nodes[root].colour == Colour::RED) {
+    ++blackHeight;
+  }
+  nodes[root].colour = Colour::BLACK;
+}
+
+template <typename T>
+bool IndexedRBTree<T>::addNode(const T& element) {
+  Index x = root;
+  Index y = NIL;
+  bool goLeft = false;
+  while (x != NIL) {
+    y = x;
+    if (element < nodes[x].element) {
+      x = nodes[x].leftChild;
+      goLeft = true;
+    } else if (nodes[x].element < element) {
+      x = nodes[x].rightChild;
+      goLeft = false;
+    } else {
+      return false;
+    }
+  }
+  // May grow the vector; indices stay valid where references would not.
+  Index newNode = allocateNode(element);
+  nodes[newNode].parent = y;
+  if (y == NIL) {
+    root = newNode;
+  } else if (goLeft) {
+    nodes[y].leftChild = newNode;
+  } else {
+    nodes[y].rightChild = newNode;
+  }
+  ++nodeCount;
+  RB_Insert_Fixup(newNode);
+  return true;
+}
+
+template <typename T>
+void IndexedRBTree<T>::RB_Transplant(Index node, Index nodechild) {
+  Index parentNode = nodes[node].parent;
+  if (parentNode == NIL) {
+    root = nodechild;
+  } else if (node == nodes[parentNode].leftChild) {
+    nodes[parentNode].leftChild = nodechild;
+  } else {
+    nodes[parentNode].rightChild = nodechild;
+  }
+  nodes[nodechild].parent = parentNode;
+}
+
+template <typename T>
+void IndexedRBTree<T>::RB_Delete_Fixup(Index node) {
+  while (node != root && nodes[node].colour == Colour::BLACK) {
+    Index parentNode = nodes[node].parent;
+    if (node == nodes[parentNode].leftChild) {
+      Index sibling = nodes[parentNode].rightChild;
+      if (nodes[sibling].colour == Colour::RED) {
+        nodes[sibling].colour = Colour::BLACK;
+        nodes[parentNode].colour = Colour::RED;
+        Left_Rotate(parentNode);
+        sibling = nodes[parentNode].rightChild;
+      }
+      if (nodes[nodes[sibling].leftChild].colour == Colour::BLACK &&
+          nodes[nodes[sibling].rightChild].colour == Colour::BLACK) {
+        nodes[sibling].colour = Colour::RED;
+        node = parentNode;
+        if (node == root && nodes[node].colour == Colour::BLACK) {
+          --blackHeight;
+        }
+      } else {
+        if (nodes[nodes[sibling].rightChild].colour == Colour::BLACK) {
+          nodes[nodes[sibling].leftChild].colour = Colour::BLACK;
+          nodes[sibling].colour = Colour::RED;
+          Right_Rotate(sibling);
+          sibling = nodes[parentNode].rightChild;
+        }
+        nodes[sibling].colour = nodes[parentNode].colour;
+        nodes[parentNode].colour = Colour::BLACK;
+        nodes[nodes[sibling].rightChild].colour = Colour::BLACK;
+        Left_Rotate(parentNode);
+        node = root;
+      }
+    } else {
+      Index sibling = nodes[parentNode].leftChild;
+      if (nodes[sibling].colour == Colour::RED) {
+        nodes[sibling].colour = Colour::BLACK;
+        nodes[parentNode].colour = Colour::RED;
+        Right_Rotate(parentNode);
+        sibling = nodes[parentNode].leftChild;
+      }
+      if (nodes[nodes[sibling].leftChild].colour == Colour::BLACK &&
+          nodes[nodes[sibling].rightChild].colour == Colour::BLACK) {
+        nodes[sibling].colour = Colour::RED;
+        node = parentNode;
+        if (node == root && nodes[node].colour == Colour::BLACK) {
+          --blackHeight;
+        }
+      } else {
+        if (nodes[nodes[sibling].leftChild].colour == Colour::BLACK) {
+          nodes[nodes[sibling].rightChild].colour = Colour::BLACK;
+          nodes[sibling].colour = Colour::RED;
+          Left_Rotate(sibling);
+          sibling = nodes[parentNode].leftChild;
+        }
+        nodes[sibling].colour = nodes[parentNode].colour;
+        nodes[parentNode].colour = Colour::BLACK;
+        nodes[nodes[sibling].leftChild].colour = Colour::BLACK;
+        Right_Rotate(parentNode);
+        node = root;
+      }
+    }
+  }
+  nodes[node].colour = Colour::BLACK;
+}
+
+template <typename T>
+bool IndexedRBTree<T>::deleteNode(const T& element) {
+  Index z = findNode(element);
+  if (z == NIL) {
+    return false;
+  }
+  Index y = z;
+  Index x = NIL;
+  Colour yOriginalColour = nodes[y].colour;
+  if (nodes[z].leftChild == NIL) {
+    x = nodes[z].rightChild;
+    RB_Transplant(z, x);
+  } else if (nodes[z].rightChild == NIL) {
+    x = nodes[z].leftChild;
+    RB_Transplant(z, x);
+  } else {
+    y = treeMinimum(nodes[z].rightChild);
+    yOriginalColour = nodes[y].colour;
+    x = nodes[y].rightChild;
+    if (nodes[y].parent == z) {
+      nodes[x].parent = y;
+    } else {
+      RB_Transplant(y, x);
+      nodes[y].rightChild = nodes[z].rightChild;
+      nodes[nodes[y].rightChild].parent = y;
+    }
+    RB_Transplant(z, y);
+    nodes[y].leftChild = nodes[z].leftChild;
+    nodes[nodes[y].leftChild].parent = y;
+    nodes[y].colour = nodes[z].colour;
+  }
+  freeNode(z);
+  --nodeCount;
+  if (yOriginalColour == Colour::BLACK) {
+    RB_Delete_Fixup(x);
+  }
+  if (root == NIL) {
+    blackHeight = 0;
+  }
+  return true;
+}
+
+template <typename T>
+typename IndexedRBTree<T>::Index IndexedRBTree<T>::findNode(
+    const T& element) {
+  Index node = root;
+  while (node != NIL) {
+    if (element < nodes[node].element) {
+      node = nodes[node].leftChild;
+    } else if (nodes[node].element < element) {
+      node = nodes[node].rightChild;
+    } else {
+      return node;
+    }
+  }
+  return NIL;
+}
+
+template <typename T>
+bool IndexedRBTree<T>::find(const T& element) {
+  return findNode(element) != NIL;
+}
+
+template <typename T>
+typename IndexedRBTree<T>::Index IndexedRBTree<T>::treeMinimum(Index node) {
+  if (node == NIL) {
+    return NIL;
+  }
+  while (nodes[node].leftChild != NIL) {
+    node = nodes[node].leftChild;
+  }
+  return node;
+}
+
+template <typename T>
+typename IndexedRBTree<T>::Index IndexedRBTree<T>::treeMaximum(Index node) {
+  if (node == NIL) {
+    return NIL;
+  }
+  while (nodes[node].rightChild != NIL) {
+    node = nodes[node].rightChild;
+  }
+  return node;
+}
+
+template <typename T>
+typename IndexedRBTree<T>::Index IndexedRBTree<T>::successor(Index node) {
+  if (nodes[node].rightChild != NIL) {
+    return treeMinimum(nodes[node].rightChild);
+  }
+  Index parentNode = nodes[node].parent;
+  while (parentNode != NIL && node == nodes[parentNode].rightChild) {
+    node = parentNode;
+    parentNode = nodes[parentNode].parent;
+  }
+  return parentNode;
+}
+
+template <typename T>
+const T& IndexedRBTree<T>::min() {
+  if (root == NIL) {
+    throw std::string("The tree is empty");
+  }
+  return nodes[treeMinimum(root)].element;
+}
+
+template <typename T>
+const T& IndexedRBTree<T>::max() {
+  if (root == NIL) {
+    throw std::string("The tree is empty");
+  }
+  return nodes[treeMaximum(root)].element;
+}
+
+template <typename T>
+std::size_t IndexedRBTree<T>::size() {
+  return nodeCount;
+}
+
+template <typename T>
+template <typename F>
+bool IndexedRBTree<T>::forEach(F fn) {
+  for (Index node = treeMinimum(root); node != NIL; node = successor(node)) {
+    if constexpr (std::is_void_v<std::invoke_result_t<F&, const T&>>) {
+      fn(nodes[node].element);
+    } else if (!fn(nodes[node].element)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T>
+std::vector<T> IndexedRBTree<T>::inOrder() {
+  std::vector<T> order;
+  order.reserve(nodeCount);
+  forEach([&](const T& element) { order.push_back(element); });
+  return order;
+}
+
+template <typename T>
+int IndexedRBTree<T>::heightRec(Index node) {
+  if (node == NIL) {
+    return -1;
+  }
+  return 1 + std::max(heightRec(nodes[node].leftChild),
+                      heightRec(nodes[node].rightChild));
+}
+
+template <typename T>
+int IndexedRBTree<T>::height() {
+  return heightRec(root);
+}
+
+template <typename T>
+std::pair<int, int> IndexedRBTree<T>::heightBounds() {
+  if (root == NIL) {
+    return {-1, -1};
+  }
+  return {blackHeight - 1, 2 * blackHeight - 1};
+}
+
+template <typename T>
+std::vector<T> IndexedRBTree<T>::pathFromRoot(const T& element) {
+  std::vector<T> path;
+  Index node = root;
+  while (node != NIL) {
+    if (element < nodes[node].element) {
+      path.push_back(nodes[node].element);
+      node = nodes[node].leftChild;
+    } else if (nodes[node].element < element) {
+      path.push_back(nodes[node].element);
+      node = nodes[node].rightChild;
+    } else {
+      if (node == root) {
+        path.push_back(nodes[node].element);
+      }
+      return path;
+    }
+  }
+  return {};
+}
+
+template <typename T>
+void IndexedRBTree<T>::clear() {
+  nodes.erase(nodes.begin() + 1, nodes.end());
+  nodes[NIL] = Node();
+  nodes[NIL].colour = Colour::BLACK;
+  root = NIL;
+  freeList = NIL;
+  nodeCount = 0;
+  blackHeight = 0;
+}
+
+template <typename T>
+void IndexedRBTree<T>::snapshot(std::vector<unsigned char>& out) {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "snapshot() copies the nodes byte by byte");
+  SnapshotHeader header{nodes.size(), nodeCount, root, freeList,
+                        blackHeight};
+  out.resize(sizeof(header) + nodes.size() * sizeof(Node));
+  std::memcpy(out.data(), &header, sizeof(header));
+  std::memcpy(out.data() + sizeof(header), nodes.data(),
+              nodes.size() * sizeof(Node));
+}
+
+template <typename T>
+void IndexedRBTree<T>::restore(const unsigned char* data, std::size_t bytes) {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "restore() copies the nodes byte by byte");
+  SnapshotHeader header;
+  if (bytes < sizeof(header)) {
+    throw std::invalid_argument("The snapshot is truncated");
+  }
+  std::memcpy(&header, data, sizeof(header));
+  // Compared by division, so that a corrupt slot count cannot overflow.
+  std::size_t nodeBytes = bytes - sizeof(header);
+  if (header.slots == 0 || nodeBytes % sizeof(Node) != 0 ||
+      nodeBytes / sizeof(Node) != header.slots ||
+      header.nodeCount >= header.slots) {
+    throw std::invalid_argument("The snapshot does not match its header");
+  }
+  std::vector<Node> restored(header.slots);
+  std::memcpy(restored.data(), data + sizeof(header), nodeBytes);
+  // Every walk trusts the links, so one past the slots would read outside
+  // the vector.
+  auto inRange = [&](Index index) { return index < header.slots; };
+  bool linked = inRange(header.root) && inRange(header.freeList);
+  for (const Node& node : restored) {
+    linked = linked && inRange(node.parent) && inRange(node.leftChild) &&
+             inRange(node.rightChild);
+  }
+  if (!linked) {
+    throw std::invalid_argument("The snapshot links to a missing slot");
+  }
+  nodes = std::move(restored);
+  nodeCount = header.nodeCount;
+  root = header.root;
+  freeList = header.freeList;
+  blackHeight = header.blackHeight;
+}
+
+#endif
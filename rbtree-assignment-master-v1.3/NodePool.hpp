@@ -0,0 +1,497 @@
+#ifndef NODEPOOL_HPP
+#define NODEPOOL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// A page, or the smallest power of two above it that holds 32 nodes.
+constexpr std::size_t slabBytesFor(std::size_t nodeBytes) {
+  std::size_t bytes = 4096;
+  while (bytes / nodeBytes < 32) {
+    bytes *= 2;
+  }
+  return bytes;
+}
+
+// Hands out memory for Nodes from SLAB_BYTES-sized slabs aligned to their
+// own size, so the slab owning a slot is found by masking its address.
+// Slabs are a page unless that holds fewer than 32 nodes, keeping the
+// memory of trees with only a few elements small. Slots are reused through
+// a per-slab free list, and allocate() only looks at the first slab with a
+// free slot. A slab is released as soon as its last slot is freed (the
+// last remaining slab is kept for reuse).
+//
+// The pool only manages memory: callers construct Nodes into allocate()d
+// slots with placement new and destroy them before deallocate().
+//
+// A slot can be lent out with lend(), e.g. when its node moves into another
+// tree. Lent slots stay allocated but are skipped by compaction, and they
+// may be freed through any pool: deallocate() always returns a slot to the
+// pool that owns its slab. A pool destroyed while some of its slots are
+// lent leaves those slabs behind, and the last deallocate() frees them.
+//
+// To compact, beginEvacuation() takes a sparsely used slab out of the
+// allocation lists. The caller then moves the nodes in slots returned by
+// nextToEvacuate() into new slots and frees the old ones. The slab is
+// released when its last slot is freed.
+template <typename Node>
+class NodePool {
+ public:
+  static constexpr std::size_t SLAB_BYTES = slabBytesFor(sizeof(Node));
+
+ private:
+  union Slot {
+    Slot* next;
+    alignas(Node) unsigned char bytes[sizeof(Node)];
+  };
+
+  // Upper bound on the slots in a slab, used to size the live bitmap.
+  static constexpr std::size_t MAX_SLOTS = SLAB_BYTES / sizeof(Slot);
+
+  struct Slab {
+    // nullptr once the owning pool is gone.
+    NodePool* owner = nullptr;
+    Slab* prev = nullptr;
+    Slab* next = nullptr;
+    Slot* freeList = nullptr;
+    // Slots handed out so far, and slots handed out and not yet freed.
+    std::size_t used = 0;
+    std::size_t live = 0;
+    // Live slots that have been lent out.
+    std::size_t lent = 0;
+    // Bit i is set while slot i is handed out and not lent.
+    std::uint64_t liveBits[(MAX_SLOTS + 63) / 64] = {};
+  };
+
+  struct SlabList {
+    Slab* head = nullptr;
+    Slab* tail = nullptr;
+
+    void unlink(Slab* slab);
+    void pushFront(Slab* slab);
+    void pushBack(Slab* slab);
+  };
+
+  static constexpr std::size_t FIRST_SLOT =
+      (sizeof(Slab) + alignof(Slot) - 1) / alignof(Slot) * alignof(Slot);
+
+ public:
+  static constexpr std::size_t SLOTS_PER_SLAB =
+      (SLAB_BYTES - FIRST_SLOT) / sizeof(Slot);
+
+  NodePool() = default;
+  ~NodePool();
+
+  NodePool(const NodePool& other) = delete;
+  NodePool& operator=(const NodePool& other) = delete;
+  NodePool(NodePool&& other) noexcept;
+  // Releases this pool's slabs first, as the destructor does.
+  NodePool& operator=(NodePool&& other) noexcept;
+
+  void* allocate();
+  // Returns slot to the pool it came from, which need not be this one.
+  static void deallocate(void* slot);
+  std::size_t slabCount() const;
+  // Marks slot, if it is one of this pool's, as lent out, or as back in
+  // this pool's use.
+  void lend(void* slot);
+  void adopt(void* slot);
+  // Takes over all of other's slabs and leaves other empty, e.g. when every
+  // node of other's tree moves into this pool's tree.
+  void absorb(NodePool& other);
+  // Hands each of this pool's slabs to a or b, whichever has more of the
+  // slots in it among forA or forB, and leaves this pool empty. Slots of
+  // forA that end up in b, or the other way round, are still to be moved
+  // by the caller.
+  void divide(const std::vector<Node*>& forA, NodePool& a,
+              const std::vector<Node*>& forB, NodePool& b);
+  // Whether slot is in one of this pool's slabs.
+  bool owns(const void* slot) const;
+
+  // Picks a slab that is at most half full and whose slots fit into the
+  // free slots of the other slabs, preferring the least used, and stops
+  // allocating from it. Returns false if there is no such slab.
+  bool beginEvacuation();
+  // A slot still in use in the slab being evacuated, or nullptr if no slab
+  // is being evacuated. The caller must free it before the next call.
+  void* nextToEvacuate();
+
+ private:
+  static_assert(SLOTS_PER_SLAB >= 16, "slab size miscomputed");
+  static_assert(SLOTS_PER_SLAB <= MAX_SLOTS, "live bitmap too small");
+  static_assert(alignof(Slot) <= SLAB_BYTES, "nodes too strictly aligned");
+
+  // Slabs with free slots, and full ones.
+  SlabList open;
+  SlabList full;
+  std::size_t slabs = 0;
+  // Slots in use across all slabs.
+  std::size_t liveSlots = 0;
+  // On neither list while its nodes are moved elsewhere.
+  Slab* evacuating = nullptr;
+  std::size_t evacuationCursor = 0;
+
+  static Slab* slabOf(const void* slot);
+  static Slot* slotAt(Slab* slab, std::size_t index);
+  static std::size_t indexOf(Slab* slab, const void* slot);
+  static bool isFull(const Slab* slab);
+  static bool isMarked(const Slab* slab, std::size_t index);
+  static void mark(Slab* slab, std::size_t index, bool used);
+  void freeSlot(Slab* slab, Slot* slot);
+  void takeOwnership();
+  void takeSlab(Slab* slab);
+  bool worthEvacuating(const Slab* slab) const;
+  void releaseSlab(Slab* slab);
+  void releaseAll();
+};
+
+template <typename Node>
+void NodePool<Node>::SlabList::unlink(Slab* slab) {
+  (slab->prev != nullptr ? slab->prev->next : head) = slab->next;
+  (slab->next != nullptr ? slab->next->prev : tail) = slab->prev;
+  slab->prev = nullptr;
+  slab->next = nullptr;
+}
+
+template <typename Node>
+void NodePool<Node>::SlabList::pushFront(Slab* slab) {
+  slab->next = head;
+  (head != nullptr ? head->prev : tail) = slab;
+  head = slab;
+}
+
+template <typename Node>
+void NodePool<Node>::SlabList::pushBack(Slab* slab) {
+  slab->prev = tail;
+  (tail != nullptr ? tail->next : head) = slab;
+  tail = slab;
+}
+
+template <typename Node>
+NodePool<Node>::~NodePool() {
+  releaseAll();
+}
+
+template <typename Node>
+NodePool<Node>::NodePool(NodePool&& other) noexcept
+    : open(std::exchange(other.open, SlabList())),
+      full(std::exchange(other.full, SlabList())),
+      slabs(std::exchange(other.slabs, 0)),
+      liveSlots(std::exchange(other.liveSlots, 0)),
+      evacuating(std::exchange(other.evacuating, nullptr)),
+      evacuationCursor(std::exchange(other.evacuationCursor, 0)) {
+  takeOwnership();
+}
+
+template <typename Node>
+NodePool<Node>& NodePool<Node>::operator=(NodePool&& other) noexcept {
+  if (this != &other) {
+    releaseAll();
+    open = std::exchange(other.open, SlabList());
+    full = std::exchange(other.full, SlabList());
+    slabs = std::exchange(other.slabs, 0);
+    liveSlots = std::exchange(other.liveSlots, 0);
+    evacuating = std::exchange(other.evacuating, nullptr);
+    evacuationCursor = std::exchange(other.evacuationCursor, 0);
+    takeOwnership();
+  }
+  return *this;
+}
+
+template <typename Node>
+typename NodePool<Node>::Slab* NodePool<Node>::slabOf(const void* slot) {
+  return reinterpret_cast<Slab*>(reinterpret_cast<std::uintptr_t>(slot) &
+                                 ~std::uintptr_t(SLAB_BYTES - 1));
+}
+
+template <typename Node>
+typename NodePool<Node>::Slot* NodePool<Node>::slotAt(Slab* slab,
+                                                      std::size_t index) {
+  return reinterpret_cast<Slot*>(reinterpret_cast<unsigned char*>(slab) +
+                                 FIRST_SLOT) +
+         index;
+}
+
+template <typename Node>
+std::size_t NodePool<Node>::indexOf(Slab* slab, const void* slot) {
+  return static_cast<const Slot*>(slot) - slotAt(slab, 0);
+}
+
+template <typename Node>
+bool NodePool<Node>::isFull(const Slab* slab) {
+  return slab->live == SLOTS_PER_SLAB;
+}
+
+template <typename Node>
+bool NodePool<Node>::isMarked(const Slab* slab, std::size_t index) {
+  return slab->liveBits[index / 64] >> (index % 64) & 1;
+}
+
+template <typename Node>
+void NodePool<Node>::mark(Slab* slab, std::size_t index, bool used) {
+  std::uint64_t bit = std::uint64_t(1) << (index % 64);
+  if (used) {
+    slab->liveBits[index / 64] |= bit;
+  } else {
+    slab->liveBits[index / 64] &= ~bit;
+  }
+}
+
+template <typename Node>
+void NodePool<Node>::takeOwnership() {
+  for (SlabList* list : {&open, &full}) {
+    for (Slab* slab = list->head; slab != nullptr; slab = slab->next) {
+      slab->owner = this;
+    }
+  }
+  if (evacuating != nullptr) {
+    evacuating->owner = this;
+  }
+}
+
+template <typename Node>
+void NodePool<Node>::releaseSlab(Slab* slab) {
+  if (slab == evacuating) {
+    evacuating = nullptr;
+  } else {
+    (isFull(slab) ? full : open).unlink(slab);
+  }
+  slab->~Slab();
+  ::operator delete(slab, std::align_val_t(SLAB_BYTES));
+  --slabs;
+}
+
+// Slabs with lent slots are left to be freed by the last deallocate();
+// the rest are released.
+template <typename Node>
+void NodePool<Node>::releaseAll() {
+  if (evacuating != nullptr) {
+    open.pushBack(std::exchange(evacuating, nullptr));
+  }
+  for (SlabList* list : {&open, &full}) {
+    while (list->head != nullptr) {
+      Slab* slab = list->head;
+      if (slab->lent == 0) {
+        releaseSlab(slab);
+      } else {
+        list->unlink(slab);
+        slab->owner = nullptr;
+        --slabs;
+      }
+    }
+  }
+  liveSlots = 0;
+}
+
+template <typename Node>
+void* NodePool<Node>::allocate() {
+  if (open.head == nullptr) {
+    Slab* slab = new (
+        ::operator new(SLAB_BYTES, std::align_val_t(SLAB_BYTES))) Slab;
+    slab->owner = this;
+    open.pushFront(slab);
+    ++slabs;
+  }
+  Slab* slab = open.head;
+  Slot* slot = slab->freeList;
+  if (slot != nullptr) {
+    slab->freeList = slot->next;
+  } else {
+    slot = slotAt(slab, slab->used++);
+  }
+  mark(slab, indexOf(slab, slot), true);
+  ++slab->live;
+  ++liveSlots;
+  if (isFull(slab)) {
+    open.unlink(slab);
+    full.pushBack(slab);
+  }
+  return slot;
+}
+
+template <typename Node>
+void NodePool<Node>::deallocate(void* slot) {
+  Slab* slab = slabOf(slot);
+  std::size_t index = indexOf(slab, slot);
+  if (isMarked(slab, index)) {
+    mark(slab, index, false);
+  } else {
+    --slab->lent;
+  }
+  if (slab->owner != nullptr) {
+    slab->owner->freeSlot(slab, static_cast<Slot*>(slot));
+  } else if (--slab->live == 0) {
+    slab->~Slab();
+    ::operator delete(slab, std::align_val_t(SLAB_BYTES));
+  }
+}
+
+template <typename Node>
+void NodePool<Node>::freeSlot(Slab* slab, Slot* freed) {
+  freed->next = slab->freeList;
+  slab->freeList = freed;
+  if (isFull(slab) && slab != evacuating) {
+    full.unlink(slab);
+    open.pushFront(slab);
+  }
+  --slab->live;
+  --liveSlots;
+  if (slab->live == 0 && (slabs > 1 || slab == evacuating)) {
+    releaseSlab(slab);
+  }
+}
+
+template <typename Node>
+std::size_t NodePool<Node>::slabCount() const {
+  return slabs;
+}
+
+template <typename Node>
+void NodePool<Node>::lend(void* slot) {
+  Slab* slab = slabOf(slot);
+  std::size_t index = indexOf(slab, slot);
+  if (slab->owner == this && isMarked(slab, index)) {
+    mark(slab, index, false);
+    ++slab->lent;
+  }
+}
+
+template <typename Node>
+void NodePool<Node>::adopt(void* slot) {
+  Slab* slab = slabOf(slot);
+  std::size_t index = indexOf(slab, slot);
+  if (slab->owner == this && !isMarked(slab, index)) {
+    mark(slab, index, true);
+    --slab->lent;
+  }
+}
+
+// Behind this pool's own slabs, which allocation keeps filling first.
+template <typename Node>
+void NodePool<Node>::takeSlab(Slab* slab) {
+  slab->owner = this;
+  (isFull(slab) ? full : open).pushBack(slab);
+  ++slabs;
+  liveSlots += slab->live;
+  if (slab->live == 0 && slabs > 1) {
+    releaseSlab(slab);
+  }
+}
+
+template <typename Node>
+void NodePool<Node>::absorb(NodePool& other) {
+  if (&other == this) {
+    return;
+  }
+  if (other.evacuating != nullptr) {
+    other.open.pushBack(std::exchange(other.evacuating, nullptr));
+  }
+  for (SlabList* list : {&other.open, &other.full}) {
+    while (list->head != nullptr) {
+      Slab* slab = list->head;
+      list->unlink(slab);
+      takeSlab(slab);
+    }
+  }
+  other.slabs = 0;
+  other.liveSlots = 0;
+  other.evacuationCursor = 0;
+}
+
+template <typename Node>
+void NodePool<Node>::divide(const std::vector<Node*>& forA, NodePool& a,
+                            const std::vector<Node*>& forB, NodePool& b) {
+  // Slots of forA minus slots of forB in each slab.
+  std::unordered_map<const Slab*, std::ptrdiff_t> balance;
+  for (const Node* node : forA) {
+    ++balance[slabOf(node)];
+  }
+  for (const Node* node : forB) {
+    --balance[slabOf(node)];
+  }
+  if (evacuating != nullptr) {
+    open.pushBack(std::exchange(evacuating, nullptr));
+  }
+  for (SlabList* list : {&open, &full}) {
+    while (list->head != nullptr) {
+      Slab* slab = list->head;
+      list->unlink(slab);
+      (balance[slab] >= 0 ? a : b).takeSlab(slab);
+    }
+  }
+  slabs = 0;
+  liveSlots = 0;
+  evacuationCursor = 0;
+}
+
+template <typename Node>
+bool NodePool<Node>::owns(const void* slot) const {
+  return slabOf(slot)->owner == this;
+}
+
+template <typename Node>
+bool NodePool<Node>::worthEvacuating(const Slab* slab) const {
+  std::size_t freeElsewhere =
+      slabs * SLOTS_PER_SLAB - liveSlots - (SLOTS_PER_SLAB - slab->live);
+  return slab->live > 0 && slab->lent == 0 &&
+         slab->live * 2 <= SLOTS_PER_SLAB &&
+         freeElsewhere >= slab->live;
+}
+
+template <typename Node>
+bool NodePool<Node>::beginEvacuation() {
+  if (evacuating != nullptr) {
+    return true;
+  }
+  Slab* candidate = open.tail;
+  if (candidate == nullptr || !worthEvacuating(candidate)) {
+    // Move every slab worth evacuating to the back of the open list, the
+    // least used last. Allocation reaches them last, and the following
+    // calls find them at the tail without scanning again.
+    std::vector<Slab*> candidates;
+    for (Slab* slab = open.head; slab != nullptr; slab = slab->next) {
+      if (worthEvacuating(slab)) {
+        candidates.push_back(slab);
+      }
+    }
+    if (candidates.empty()) {
+      return false;
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Slab* a, const Slab* b) { return a->live > b->live; });
+    for (Slab* slab : candidates) {
+      open.unlink(slab);
+      open.pushBack(slab);
+    }
+    candidate = open.tail;
+  }
+  open.unlink(candidate);
+  evacuating = candidate;
+  evacuationCursor = 0;
+  return true;
+}
+
+template <typename Node>
+void* NodePool<Node>::nextToEvacuate() {
+  if (evacuating == nullptr) {
+    return nullptr;
+  }
+  // Slots before the cursor have been moved already and are never handed
+  // out again, so the scan resumes where it stopped.
+  while (evacuationCursor < evacuating->used) {
+    if (isMarked(evacuating, evacuationCursor)) {
+      return slotAt(evacuating, evacuationCursor);
+    }
+    ++evacuationCursor;
+  }
+  // Only slots lent out since the evacuation began are left.
+  open.pushBack(std::exchange(evacuating, nullptr));
+  return nullptr;
+}
+
+#endif
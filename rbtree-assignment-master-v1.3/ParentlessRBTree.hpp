@@ -0,0 +1,473 @@
+#ifndef PARENTLESSRBTREE_HPP
+#define PARENTLESSRBTREE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "RBTree.hpp"
+
+// A red-black tree whose nodes have no parent link. Insert and delete
+// record the nodes they pass on the way down in a fixed-size array and
+// rebalance bottom-up from it, so a node is two pointers, a colour and the
+// element. Leaves are nullptr rather than a shared nil node.
+template <typename T>
+class ParentlessRBTree {
+ private:
+  struct Node {
+    Node* leftChild = nullptr;
+    Node* rightChild = nullptr;
+    Colour colour = Colour::RED;
+    T element = T();
+  };
+
+  // A red-black tree with n nodes is at most 2 * log2(n + 1) nodes deep, so
+  // 128 entries cover any tree that fits in memory. Two more leave room for
+  // the rotation in delete that pushes a path one level deeper.
+  static constexpr int MAX_DEPTH = 130;
+
+  Node* root = nullptr;
+  std::size_t nodeCount = 0;
+  // Number of black nodes on every path from root down to a leaf.
+  int blackHeight = 0;
+
+  static bool isRed(const Node* node);
+  static Node* rotateLeft(Node* node);
+  static Node* rotateRight(Node* node);
+  void replaceChild(Node* parentNode, Node* oldChild, Node* newChild);
+  void insertFixup(Node** path, int depth);
+  void deleteFixup(Node** path, int depth, Node* x, bool xIsLeft);
+  int heightRec(const Node* node);
+
+ public:
+  // Bytes taken by one node, before any allocator overhead.
+  static constexpr std::size_t NODE_BYTES = sizeof(Node);
+
+  ParentlessRBTree() = default;
+  ~ParentlessRBTree();
+
+  ParentlessRBTree(const ParentlessRBTree& other) = delete;
+  ParentlessRBTree& operator=(const ParentlessRBTree& other) = delete;
+
+  bool addNode(const T& element);
+  bool deleteNode(const T& element);
+  bool find(const T& element);
+  const T& min();
+  const T& max();
+  std::size_t size();
+  std::vector<T> inOrder();
+  // Calls fn on every element in ascending order. fn may return bool, in
+  // which case returning false stops the traversal early.
+  template <typename F>
+  bool forEach(F fn);
+  int height();
+  std::pair<int, int> heightBounds();
+  std::vector<T> pathFromRoot(const T& element);
+};
+
+// Flattens the tree into a right-leaning list with right rotations and
+// frees it front to back, without recursion or an explicit stack.
+template <typename T>
+ParentlessRBTree<T>::~ParentlessRBTree() {
+  Node* curr = root;
+  while (curr != nullptr) {
+    if (curr->leftChild != nullptr) {
+      Node* leftNode = curr->leftChild;
+      curr->leftChild = leftNode->rightChild;
+      leftNode->rightChild = curr;
+      curr = leftNode;
+    } else {
+      Node* next = curr->rightChild;
+      delete curr;
+      curr = next;
+    }
+  }
+}
+
+template <typename T>
+bool ParentlessRBTree<T>::isRed(const Node* node) {
+  return node != nullptr && node->colour == Colour::RED;
+}
+
+template <typename T>
+typename ParentlessRBTree<T>::Node* ParentlessRBTree<T>::rotateLeft(
+    Node* node) {
+  Node* rotateNode = node->rightChild;
+  node->rightChild = rotateNode->leftChild;
+  rotateNode->leftChild = node;
+  return rotateNode;
+}
+
+template <typename T>
+typename ParentlessRBTree<T>::Node* ParentlessRBTree<T>::rotateRight(
+    Node* node) {
+  Node* rotateNode = node->leftChild;
+  node->leftChild = rotateNode->rightChild;
+  rotateNode->rightChild = node;
+  return rotateNode;
+}
+
+// Points whichever link of parentNode held oldChild at newChild. A
+// nullptr parentNode stands for the root link.
+template <typename T>
+void ParentlessRBTree<T>::replaceChild(Node* parentNode, Node* oldChild,
+                                       Node* newChild) {
+  if (parentNode == nullptr) {
+    root = newChild;
+  } else if (parentNode->leftChild == oldChild) {
+    parentNode->leftChild = newChild;
+  } else {
+    parentNode->rightChild = newChild;
+  }
+}
+
+// path[depth] is the new red node and path[0 .. depth - 1] its ancestors.
+template <typename T>
+void ParentlessRBTree<T>::insertFixup(Node** path, int depth) {
+  int i = depth;
+  // A red parent is never the root, so the grandparent exists.
+  while (i >= 2 && isRed(path[i - 1])) {
+    Node* node = path[i];
+    Node* parentNode = path[i - 1];
+    Node* grandparent = path[i - 2];
+    Node* greatGrandparent = i >= 3 ? path[i - 3] : nullptr;
+    if (parentNode == grandparent->leftChild) {
+      Node* uncle = grandparent->rightChild;
+      if (isRed(uncle)) {
+        parentNode->colour = Colour::BLACK;
+        uncle->colour = Colour::BLACK;
+        grandparent->colour = Colour::RED;
+        i -= 2;
+        continue;
+      }
+      if (node == parentNode->rightChild) {
+        grandparent->leftChild = rotateLeft(parentNode);
+        parentNode = node;
+      }
+      parentNode->colour = Colour::BLACK;
+      grandparent->colour = Colour::RED;
+      replaceChild(greatGrandparent, grandparent, rotateRight(grandparent));
+    } else {
+      Node* uncle = grandparent->leftChild;
+      if (isRed(uncle)) {
+        parentNode->colour = Colour::BLACK;
+        uncle->colour = Colour::BLACK;
+        grandparent->colour = Colour::RED;
+        i -= 2;
+        continue;
+      }
+      if (node == parentNode->leftChild) {
+        grandparent->rightChild = rotateRight(parentNode);
+        parentNode = node;
+      }
+      parentNode->colour = Colour::BLACK;
+      grandparent->colour = Colour::RED;
+      replaceChild(greatGrandparent, grandparent, rotateLeft(grandparent));
+    }
+    break;
+  }
+  if (root->colour == Colour::RED) {
+    ++blackHeight;
+  }
+  root->colour = Colour::BLACK;
+}
+
+template <typename T>
+bool ParentlessRBTree<T>::addNode(const T& element) {
+  Node* path[MAX_DEPTH];
+  int depth = 0;
+  Node* curr = root;
+  bool goLeft = false;
+  while (curr != nullptr) {
+    path[depth++] = curr;
+    if (element < curr->element) {
+      curr = curr->leftChild;
+      goLeft = true;
+    } else if (curr->element < element) {
+      curr = curr->rightChild;
+      goLeft = false;
+    } else {
+      return false;
+    }
+  }
+  Node* newNode = new Node;
+  newNode->element = element;
+  if (depth == 0) {
+    root = newNode;
+  } else if (goLeft) {
+    path[depth - 1]->leftChild = newNode;
+  } else {
+    path[depth - 1]->rightChild = newNode;
+  }
+  path[depth] = newNode;
+  ++nodeCount;
+  insertFixup(path, depth);
+  return true;
+}
+
+// x (possibly nullptr) took the place of a removed black node and sits at
+// path[depth]; path[0 .. depth - 1] are its ancestors and xIsLeft tells
+// which side of path[depth - 1] it is on.
+template <typename T>
+void ParentlessRBTree<T>::deleteFixup(Node** path, int depth, Node* x,
+                                      bool xIsLeft) {
+  int i = depth;
+  while (i > 0 && !isRed(x)) {
+    Node* parentNode = path[i - 1];
+    Node* grandparent = i >= 2 ? path[i - 2] : nullptr;
+    if (xIsLeft) {
+      Node* sibling = parentNode->rightChild;
+      if (isRed(sibling)) {
+        sibling->colour = Colour::BLACK;
+        parentNode->colour = Colour::RED;
+        replaceChild(grandparent, parentNode, rotateLeft(parentNode));
+        // The sibling is now between grandparent and parentNode.
+        path[i - 1] = sibling;
+        path[i] = parentNode;
+        ++i;
+        sibling = parentNode->rightChild;
+      }
+      if (!isRed(sibling->leftChild) && !isRed(sibling->rightChild)) {
+        sibling->colour = Colour::RED;
+        x = parentNode;
+        --i;
+        xIsLeft = i > 0 && path[i - 1]->leftChild == x;
+        if (i == 0 && !isRed(x)) {
+          --blackHeight;
+        }
+      } else {
+        if (!isRed(sibling->rightChild)) {
+          sibling->leftChild->colour = Colour::BLACK;
+          sibling->colour = Colour::RED;
+          parentNode->rightChild = rotateRight(sibling);
+          sibling = parentNode->rightChild;
+        }
+        sibling->colour = parentNode->colour;
+        parentNode->colour = Colour::BLACK;
+        sibling->rightChild->colour = Colour::BLACK;
+        replaceChild(i >= 2 ? path[i - 2] : nullptr, parentNode,
+                     rotateLeft(parentNode));
+        x = root;
+        break;
+      }
+    } else {
+      Node* sibling = parentNode->leftChild;
+      if (isRed(sibling)) {
+        sibling->colour = Colour::BLACK;
+        parentNode->colour = Colour::RED;
+        replaceChild(grandparent, parentNode, rotateRight(parentNode));
+        path[i - 1] = sibling;
+        path[i] = parentNode;
+        ++i;
+        sibling = parentNode->leftChild;
+      }
+      if (!isRed(sibling->leftChild) && !isRed(sibling->rightChild)) {
+        sibling->colour = Colour::RED;
+        x = parentNode;
+        --i;
+        xIsLeft = i > 0 && path[i - 1]->leftChild == x;
+        if (i == 0 && !isRed(x)) {
+          --blackHeight;
+        }
+      } else {
+        if (!isRed(sibling->leftChild)) {
+          sibling->rightChild->colour = Colour::BLACK;
+          sibling->colour = Colour::RED;
+          parentNode->leftChild = rotateLeft(sibling);
+          sibling = parentNode->leftChild;
+        }
+        sibling->colour = parentNode->colour;
+        parentNode->colour = Colour::BLACK;
+        sibling->leftChild->colour = Colour::BLACK;
+        replaceChild(i >= 2 ? path[i - 2] : nullptr, parentNode,
+                     rotateRight(parentNode));
+        x = root;
+        break;
+      }
+    }
+  }
+  if (x != nullptr) {
+    x->colour = Colour::BLACK;
+  }
+}
+
+template <typename T>
+bool ParentlessRBTree<T>::deleteNode(const T& element) {
+  Node* path[MAX_DEPTH];
+  int depth = 0;
+  Node* target = root;
+  while (target != nullptr && !(element == target->element)) {
+    path[depth++] = target;
+    target = element < target->element ? target->leftChild
+                                       : target->rightChild;
+  }
+  if (target == nullptr) {
+    return false;
+  }
+  Node* parentNode = depth > 0 ? path[depth - 1] : nullptr;
+  int targetDepth = depth;
+  path[depth++] = target;
+
+  Node* x = nullptr;
+  bool xIsLeft = false;
+  Colour removedColour = target->colour;
+  if (target->leftChild == nullptr || target->rightChild == nullptr) {
+    x = target->leftChild != nullptr ? target->leftChild : target->rightChild;
+    xIsLeft = parentNode != nullptr && parentNode->leftChild == target;
+    replaceChild(parentNode, target, x);
+    path[targetDepth] = x;
+    depth = targetDepth;
+  } else {
+    // Move the successor into target's place, keeping the path to the
+    // successor's old position valid for the fixup.
+    Node* successorNode = target->rightChild;
+    while (successorNode->leftChild != nullptr) {
+      path[depth++] = successorNode;
+      successorNode = successorNode->leftChild;
+    }
+    removedColour = successorNode->colour;
+    x = successorNode->rightChild;
+    if (successorNode == target->rightChild) {
+      xIsLeft = false;
+    } else {
+      Node* successorParent = path[depth - 1];
+      successorParent->leftChild = x;
+      successorNode->rightChild = target->rightChild;
+      xIsLeft = true;
+    }
+    successorNode->leftChild = target->leftChild;
+    successorNode->colour = target->colour;
+    replaceChild(parentNode, target, successorNode);
+    path[targetDepth] = successorNode;
+  }
+  delete target;
+  --nodeCount;
+  if (removedColour == Colour::BLACK) {
+    deleteFixup(path, depth, x, xIsLeft);
+  }
+  if (root == nullptr) {
+    blackHeight = 0;
+  }
+  return true;
+}
+
+template <typename T>
+bool ParentlessRBTree<T>::find(const T& element) {
+  Node* curr = root;
+  while (curr != nullptr) {
+    if (element < curr->element) {
+      curr = curr->leftChild;
+    } else if (curr->element < element) {
+      curr = curr->rightChild;
+    } else {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename T>
+const T& ParentlessRBTree<T>::min() {
+  if (root == nullptr) {
+    throw std::string("The tree is empty");
+  }
+  Node* curr = root;
+  while (curr->leftChild != nullptr) {
+    curr = curr->leftChild;
+  }
+  return curr->element;
+}
+
+template <typename T>
+const T& ParentlessRBTree<T>::max() {
+  if (root == nullptr) {
+    throw std::string("The tree is empty");
+  }
+  Node* curr = root;
+  while (curr->rightChild != nullptr) {
+    curr = curr->rightChild;
+  }
+  return curr->element;
+}
+
+template <typename T>
+std::size_t ParentlessRBTree<T>::size() {
+  return nodeCount;
+}
+
+template <typename T>
+template <typename F>
+bool ParentlessRBTree<T>::forEach(F fn) {
+  Node* stack[MAX_DEPTH];
+  int depth = 0;
+  Node* curr = root;
+  while (curr != nullptr || depth > 0) {
+    while (curr != nullptr) {
+      stack[depth++] = curr;
+      curr = curr->leftChild;
+    }
+    curr = stack[--depth];
+    if constexpr (std::is_void_v<std::invoke_result_t<F&, const T&>>) {
+      fn(curr->element);
+    } else if (!fn(curr->element)) {
+      return false;
+    }
+    curr = curr->rightChild;
+  }
+  return true;
+}
+
+template <typename T>
+std::vector<T> ParentlessRBTree<T>::inOrder() {
+  std::vector<T> order;
+  order.reserve(nodeCount);
+  forEach([&](const T& element) { order.push_back(element); });
+  return order;
+}
+
+template <typename T>
+int ParentlessRBTree<T>::heightRec(const Node* node) {
+  if (node == nullptr) {
+    return -1;
+  }
+  return 1 + std::max(heightRec(node->leftChild), heightRec(node->rightChild));
+}
+
+template <typename T>
+int ParentlessRBTree<T>::height() {
+  return heightRec(root);
+}
+
+template <typename T>
+std::pair<int, int> ParentlessRBTree<T>::heightBounds() {
+  if (root == nullptr) {
+    return {-1, -1};
+  }
+  return {blackHeight - 1, 2 * blackHeight - 1};
+}
+
+template <typename T>
+std::vector<T> ParentlessRBTree<T>::pathFromRoot(const T& element) {
+  std::vector<T> path;
+  Node* curr = root;
+  while (curr != nullptr) {
+    if (element < curr->element) {
+      path.push_back(curr->element);
+      curr = curr->leftChild;
+    } else if (curr->element < element) {
+      path.push_back(curr->element);
+      curr = curr->rightChild;
+    } else {
+      if (curr == root) {
+        path.push_back(curr->element);
+      }
+      return path;
+    }
+  }
+  return {};
+}
+
+#endif
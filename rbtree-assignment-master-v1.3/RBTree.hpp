@@ -1,17 +1,51 @@
 #ifndef RBTREE_HPP
 #define RBTREE_HPP
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
+#if !defined(__GNUC__) && (defined(_M_IX86) || defined(_M_X64))
+#include <xmmintrin.h>
+#endif
+#if defined(__cpp_impl_three_way_comparison)
+#include <compare>
+#endif
 
 #define FMT_HEADER_ONLY
 #include <fmt/format.h>
 
+#include "FrozenRBTree.hpp"
+#include "NodePool.hpp"
+
 enum class Colour { RED, BLACK };
 
+// STANDARD nodes store the colour in a field of its own. COMPACT nodes store
+// it in the lowest bit of the parent link instead, saving a word per node
+// whenever T is pointer aligned.
+enum class NodeLayout { STANDARD, COMPACT };
+
+// How far ahead descents prefetch nodes before comparing against them. Only
+// pays off once the tree no longer fits in the cache.
+enum class Prefetch { NONE, CHILDREN, GRANDCHILDREN };
+
+// The subtree hash RBTree nodes carry if the tree has a Hash; empty, and so
+// taking no space, otherwise.
+template <bool Hashed>
+struct SubtreeHash {};
+template <>
+struct SubtreeHash<true> {
+  std::uint64_t subtreeHash = 0;
+};
+
 namespace std {
-std::string to_string(const std::string& str) { return str; }
-std::string to_string(const Colour& colour) {
+inline std::string to_string(const std::string& str) { return str; }
+inline std::string to_string(const Colour& colour) {
   return (colour == Colour::RED) ? "RED" : "BLACK";
 }
 }  // namespace std
@@ -20,36 +54,205 @@ std::string to_string(const Colour& colour) {
 template <typename V>
 class RBReader;
 
-template <typename T>
+// With a Hash, a function object such as std::hash<T>, every node also
+// keeps a hash of the elements below it, which diff() uses to skip the
+// parts two trees have in common.
+template <typename T, NodeLayout Layout = NodeLayout::STANDARD,
+          typename Hash = void>
 class RBTree {
   friend RBReader<T>;
 
  private:
-  struct Node {
-    Node* parent = nullptr;
-    Node* leftChild = nullptr;
-    Node* rightChild = nullptr;
+  static constexpr bool HASHED = !std::is_void<Hash>::value;
+
+  struct StandardNode : SubtreeHash<HASHED> {
+    StandardNode* parent = nullptr;
+    StandardNode* leftChild = nullptr;
+    StandardNode* rightChild = nullptr;
     Colour colour = Colour::RED;
-    T element = T();
+    // Levels from this node down to the deepest leaf below it, 0 for nilNode.
+    std::uint8_t subtreeHeight = 0;
+    // Constructed by allocateNode() and destroyed by freeNode(), so T needs
+    // no default constructor and nilNode holds no element at all.
+    union {
+      T element;
+    };
+    StandardNode() {}
+    ~StandardNode() {}
   };
+  // A set lowest bit in parentAndColour means BLACK. Node addresses are
+  // pointer aligned, so the bit is never part of the address.
+  struct CompactNode : SubtreeHash<HASHED> {
+    std::uintptr_t parentAndColour = 0;
+    CompactNode* leftChild = nullptr;
+    CompactNode* rightChild = nullptr;
+    std::uint8_t subtreeHeight = 0;
+    union {
+      T element;
+    };
+    CompactNode() {}
+    ~CompactNode() {}
+  };
+  static_assert(alignof(CompactNode) > 1, "the colour bit needs alignment");
+  using Node = std::conditional_t<Layout == NodeLayout::COMPACT, CompactNode,
+                                  StandardNode>;
 
-  Node* root = nullptr;
-  Node* nilNode = nullptr;
+  // Every node except nilNode lives in pool.
+  NodePool<Node> pool;
+  Node* nilNode = sentinel();
+  Node* root = nilNode;
+  std::size_t nodeCount = 0;
+  Prefetch prefetchMode = Prefetch::NONE;
+  // Number of black nodes on every path from root down to nil (nil excluded).
+  // Kept up to date by the insert and delete fixups.
+  int blackHeight = 0;
+  // While smallMode is set the elements are kept sorted in small instead of
+  // in nodes, and root is nilNode. See setSmallLimit().
+  std::size_t smallLimit = 0;
+  bool smallMode = false;
+  std::vector<T> small;
 
+  static Node* parentOf(const Node* node);
+  static void setParent(Node* node, Node* parentNode);
+  static Colour colourOf(const Node* node);
+  static void setColour(Node* node, Colour colour);
+  static Node* sentinel();
   void RB_Insert_Fixup(Node* TheNode);
   void Left_Rotate(Node* GrandfatherNode);
   void Right_Rotate(Node* TheNode2);
-  void inOrderRec(Node* CurrNode, std::vector<T>& inOrderVec);
-  int heightRec(Node* CurrNode);
+  Node* treeMinimum(Node* node);
+  Node* treeMaximum(Node* node);
+  Node* successor(Node* node);
+  Node* predecessor(Node* node);
+  template <typename... Args>
+  Node* allocateNode(Args&&... args);
+  static void freeNode(Node* node);
+  static Node* relocateNode(Node* node, NodePool<Node>& into);
+  static std::uint64_t elementHash(const T& element);
+  void updateSubtree(Node* node);
+  void updateSubtreesUp(Node* node);
+  void updateHeightsUp(Node* node);
+  std::uint64_t hashBelow(const T* bound, bool inclusive);
+  template <typename OutputIt>
+  OutputIt copyRange(const T* lo, const T* hi, OutputIt out);
+  template <typename OutputIt>
+  OutputIt diffSubtree(Node* node, const T* lo, const T* hi, RBTree& other,
+                       OutputIt out);
+  template <typename U>
+  bool addElement(U&& element);
+  void moveNode(Node* node);
+  Node* findNode(const T& element);
+  Node* findNext(const T& element, Node*& curr) const;
+  T* findElement(const T& element);
+  bool findInsertionParent(const T& element, Node*& parentNode);
+  void linkNode(Node* newNode, Node* y);
+  void unlinkNode(Node* tmpNode);
+  void clearNodes();
+  void swapNodes(RBTree& other);
+  void collectNodes(std::vector<Node*>& nodes);
+  void buildFromSortedNodes(const std::vector<Node*>& nodes);
+  static int fullLevels(std::size_t count);
+  Node* buildRange(const std::vector<Node*>& nodes, std::size_t first,
+                   std::size_t last, Node* parentNode, int depth,
+                   int redDepth);
+  // A detached subtree and the number of black nodes on its paths, top
+  // included.
+  struct Subtree {
+    Node* top;
+    int blackHeight;
+  };
+  void joinSubtrees(Subtree left, Node* pivot, Subtree right);
+  void splitSubtree(Node* top, int topHeight, const T& element,
+                    Subtree& less, Subtree& rest);
+  std::size_t freeSubtree(Node* top);
+  void joinAbove(RBTree& other);
+  // Steps through the elements in ascending order, from the sorted array
+  // or the nodes, so that two trees can be walked side by side.
+  class Cursor {
+   public:
+    explicit Cursor(const RBTree& tree) : tree(tree), node(tree.root) {
+      descendLeft();
+    }
+    // Starts at the first element greater than after.
+    Cursor(const RBTree& tree, const T& after)
+        : tree(tree), node(tree.nilNode) {
+      if (tree.smallMode){
+        index = std::upper_bound(tree.small.begin(), tree.small.end(), after) -
+                tree.small.begin();
+        return;
+      }
+      for (Node* curr = tree.root; curr != tree.nilNode;){
+        if (after < curr->element){
+          node = curr;
+          curr = curr->leftChild;
+        }
+        else{
+          curr = curr->rightChild;
+        }
+      }
+    }
+    bool done() const {
+      return tree.smallMode ? index == tree.small.size()
+                            : node == tree.nilNode;
+    }
+    const T& operator*() const {
+      return tree.smallMode ? tree.small[index] : node->element;
+    }
+    void next() {
+      if (tree.smallMode){
+        ++index;
+      }
+      else if (node->rightChild != tree.nilNode){
+        node = node->rightChild;
+        descendLeft();
+      }
+      else{
+        Node* parentNode = parentOf(node);
+        while (parentNode != tree.nilNode && node == parentNode->rightChild){
+          node = parentNode;
+          parentNode = parentOf(parentNode);
+        }
+        node = parentNode;
+      }
+    }
+
+   private:
+    void descendLeft() {
+      if (node == tree.nilNode){
+        return;
+      }
+      while (node->leftChild != tree.nilNode){
+        node = node->leftChild;
+      }
+    }
+
+    const RBTree& tree;
+    Node* node;
+    std::size_t index = 0;
+  };
+  void mergeOverlapping(RBTree& other);
+  std::size_t smallLowerBound(const T& element);
+  bool smallFind(const T& element);
+  void promote();
+  void demote();
+  void vebOrder(Node* node, int levels, std::vector<Node*>& order);
+  void vebOrderBelow(Node* node, int depth, int levels,
+                     std::vector<Node*>& order);
+  template <typename F>
+  static bool visit(F& fn, const T& element);
   void RB_Transplant(Node* node, Node* nodechild);
-  void RB_Delete_Fixup(Node* currentnode);
-  bool findrec(Node* currnode, const T& element);
+  void RB_Delete_Fixup(Node* currentnode, Node* parentNode);
+  void prefetchChildren(const Node* node);
+  static void prefetchNode(const Node* node);
 
   int GzAddNode(std::string& nodes, std::string& connections, const Node* curr,
                 size_t to);
   int GzAddChild(std::string& nodes, std::string& connections,
                  const Node* child, size_t from, size_t to,
                  const std::string& color);
+  int GzAddSmall(std::string& nodes, std::string& connections,
+                 std::size_t first, std::size_t last, int depth, int redDepth,
+                 size_t to);
   template <typename V>
   std::string GzNode(size_t to, const V& what, const std::string& style,
                      const std::string& fillColor,
@@ -58,6 +261,42 @@ class RBTree {
                            const std::string& style);
 
  public:
+  // Bytes taken by one node, before any allocator overhead.
+  static constexpr std::size_t NODE_BYTES = sizeof(Node);
+
+  // Owns a node taken out of a tree by extract(). insert() links it into
+  // any tree of the same type without allocating or copying the element.
+  class NodeHandle {
+   public:
+    NodeHandle() = default;
+    NodeHandle(NodeHandle&& other) noexcept
+        : node(std::exchange(other.node, nullptr)) {}
+    NodeHandle& operator=(NodeHandle&& other) noexcept {
+      if (this != &other){
+        reset();
+        node = std::exchange(other.node, nullptr);
+      }
+      return *this;
+    }
+    ~NodeHandle() { reset(); }
+
+    bool empty() const { return node == nullptr; }
+    explicit operator bool() const { return node != nullptr; }
+    // The element may be changed before the handle is inserted again.
+    T& value() const { return node->element; }
+
+   private:
+    friend RBTree;
+    explicit NodeHandle(Node* node) : node(node) {}
+    void reset() {
+      if (node != nullptr){
+        freeNode(std::exchange(node, nullptr));
+      }
+    }
+
+    Node* node = nullptr;
+  };
+
   RBTree();
   ~RBTree();
 
@@ -66,23 +305,218 @@ class RBTree {
   RBTree(RBTree&& other) = delete;
   RBTree& operator=(RBTree&& other) = delete;
   bool addNode(const T& element);
+  bool addNode(T&& element);
+  // Constructs the element from args directly inside its node. If an equal
+  // element is already in the tree, the new one is destroyed again and
+  // false is returned.
+  template <typename... Args>
+  bool emplace(Args&&... args);
   bool deleteNode(const T& element);
+  // Takes element out of the tree together with its node. Returns an empty
+  // handle if element is not found.
+  NodeHandle extract(const T& element);
+  // Links the handle's node into this tree and empties the handle. Returns
+  // false, leaving the handle as it was, if the element is already in the
+  // tree or the handle is empty.
+  bool insert(NodeHandle&& handle);
+  // Replaces oldKey by newKey, reusing its node. If newKey still sorts
+  // between the neighbours of oldKey, the element is just overwritten;
+  // otherwise the node is unlinked and linked in again at its new place.
+  // Returns false if oldKey is missing or newKey is already in the tree.
+  bool rekey(const T& oldKey, const T& newKey);
+  // Deletes every element x with lo <= x < hi and returns how many there
+  // were. The tree is split around the range and joined again, so besides
+  // freeing the nodes this costs O(log n) instead of a fixup per element.
+  std::size_t eraseRange(const T& lo, const T& hi);
+  // Deletes every element for which pred returns true and returns how many
+  // there were. If that is a large part of the tree, the survivors are
+  // relinked into a new balanced tree in one pass instead.
+  // pred is called on the elements in ascending order.
+  template <typename F>
+  std::size_t eraseIf(F pred);
+  // Deletes every element in [first, last), which need not be sorted, and
+  // returns how many were in the tree. Batches that are a large part of the
+  // tree rebuild the survivors as in eraseIf(). Smaller ones are deleted in
+  // sorted order and still pay an unlink and fixup per key, as deleteNode()
+  // does; dense batches only share the walk that locates their nodes.
+  template <typename InputIt>
+  std::size_t deleteBatch(InputIt first, InputIt last);
+  // Moves the elements for which pred returns true into matching and the
+  // others into rest, emptying this tree. Whatever the two held before is
+  // deleted. pred is called on the elements in ascending order, and both
+  // trees are then built from the relinked nodes in linear time. A node is
+  // only copied if most of its slab goes to the other tree, so both trees
+  // own all of their nodes. If this tree keeps its elements in the sorted
+  // array, they are moved into sorted arrays instead, or into nodes built
+  // in one linear pass for an output whose small limit they exceed. Throws
+  // if matching or rest is this tree, or if they are the same tree.
+  template <typename F>
+  void partition(F pred, RBTree& matching, RBTree& rest);
+  // Moves every element of other that is not already in this tree into it
+  // by relinking other's nodes, without copying or allocating. Elements in
+  // both trees stay in other. If all of other's elements sort before or all
+  // after this tree's, the trees are joined along one spine in O(log n)
+  // instead of inserting node by node. Taking over other's slabs adds one
+  // step per slab.
+  void merge(RBTree& other);
   bool find(const T& element);
+  // The stored element equal to element, or nullptr if there is none. The
+  // pointer is invalidated by deleting the element, and by any change to
+  // the tree while it keeps its elements in the sorted array, or by
+  // relayout() and compaction, which move nodes.
+  const T* findPtr(const T& element);
+  // Calls fn with the stored element equal to element, which it may change
+  // in place as long as its order relative to the other elements stays the
+  // same. Returns false, without calling fn, if there is no such element.
+  template <typename F>
+  bool modify(const T& element, F fn);
+  // Sets out[i] to find(keys[i]). Runs many descents side by side so their
+  // cache misses overlap, which pays off for large batches on large trees.
+  void findBatch(const std::vector<T>& keys, std::vector<bool>& out);
+  // Writes find(key) for every key in [first, last), which must be sorted in
+  // ascending order. The tree is walked once in key order instead of
+  // descending from the root for every key.
+  template <typename InputIt, typename OutputIt>
+  OutputIt findSorted(InputIt first, InputIt last, OutputIt out);
+  // Two trees are equal if they hold the same number of elements and none
+  // of them sorts before the other's at the same position. Both are walked
+  // side by side until the first difference, without allocating.
+  bool operator==(const RBTree& other) const;
+  bool operator!=(const RBTree& other) const;
+  // Compares the elements in ascending order lexicographically and returns
+  // a negative number, zero or a positive number if this tree sorts before,
+  // equal to or after other.
+  int compare(const RBTree& other) const;
+#if defined(__cpp_impl_three_way_comparison)
+  std::weak_ordering operator<=>(const RBTree& other) const;
+#endif
+  // True if every element of this tree is also in other. If this tree is
+  // much smaller, its elements are looked up in other in one walk as in
+  // findSorted() instead of walking all of other.
+  bool isSubsetOf(const RBTree& other) const;
+  // Writes, in ascending order, every element that is in only one of the two
+  // trees, and this tree's version of every element whose equal in other
+  // hashes differently. Subtrees whose hash matches that of the same key
+  // range in other are skipped, so the cost grows with the number of
+  // differences instead of the size of the trees. Barring hash collisions,
+  // nothing is missed. Needs a Hash, and moves this tree to nodes first.
+  template <typename OutputIt>
+  OutputIt diff(RBTree& other, OutputIt out);
   const T& min();
   const T& max();
-  std::vector<T> inOrder();
+  std::size_t size();
+  // Deletes every element.
+  void clear();
+  void setPrefetch(Prefetch mode);
+  // Keeps up to limit elements in one sorted array instead of in nodes,
+  // which is faster and far smaller for small sets. The tree moves to nodes
+  // once it grows past limit, and back once it shrinks to limit / 2.
+  // height(), heightBounds(), pathFromRoot() and ToGraphviz() then describe
+  // the balanced tree the array would be moved into, without moving it.
+  // 0, the default, turns this off.
+  void setSmallLimit(std::size_t limit);
+  std::vector<T> inOrder() &;
+  // Moves the elements out and leaves the tree empty.
+  std::vector<T> inOrder() &&;
+  // Calls fn on every element in ascending (descending) order. fn may return
+  // bool, in which case returning false stops the traversal early. Returns
+  // false if the traversal was stopped.
+  template <typename F>
+  bool forEach(F fn);
+  template <typename F>
+  bool forEachReverse(F fn);
+  template <typename OutputIt>
+  OutputIt inOrderInto(OutputIt out);
+  // Copies the elements into an immutable FrozenRBTree, whose lookups are
+  // several times faster for read-mostly data. Later changes to this tree
+  // are not reflected in it.
+  FrozenRBTree<T> freeze();
+  // Moves every node into freshly allocated slabs in van Emde Boas order,
+  // so that the top levels of each subtree share cache lines and pages.
+  // Worth calling after heavy churn has scattered the nodes.
+  void relayout();
+  // Moves at most maxMoves nodes out of sparsely used slabs into the free
+  // slots of denser ones, releasing each slab once it is empty. Returns true
+  // when there is nothing left worth compacting. Call repeatedly, e.g.
+  // between requests, to shrink the tree's memory after mass deletes.
+  bool compactStep(std::size_t maxMoves);
+  // Runs compactStep() in small batches until budget has passed.
+  bool compactFor(std::chrono::nanoseconds budget);
+  // Number of slabs the nodes are allocated from.
+  std::size_t slabCount();
+  // Counted in edges; -1 for an empty tree. O(1), as every node keeps the
+  // height of its subtree up to date.
   int height();
+  // Bounds on height() that follow from the black height, in O(1).
+  std::pair<int, int> heightBounds();
+  // The ancestors of element, from the root down, and element itself only
+  // if it is the root. Empty if element is not in the tree.
   std::vector<T> pathFromRoot(const T& element);
+  // Appends what pathFromRoot(element) returns to path. Returns false and
+  // leaves path as it was if element is not found.
+  bool pathFromRoot(const T& element, std::vector<T>& path);
   std::string ToGraphviz();
 };
 
-template <typename T>
-RBTree<T>::RBTree() {
-  Node* x = new Node;
-  x->colour = Colour::BLACK;
-  nilNode = x;
-  root = nilNode;
+template <typename T, NodeLayout Layout, typename Hash>
+typename RBTree<T, Layout, Hash>::Node* RBTree<T, Layout, Hash>::parentOf(
+    const Node* node) {
+  if constexpr (Layout == NodeLayout::COMPACT){
+    return reinterpret_cast<Node*>(node->parentAndColour &
+                                   ~std::uintptr_t(1));
+  }
+  else{
+    return node->parent;
+  }
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::setParent(Node* node, Node* parentNode) {
+  if constexpr (Layout == NodeLayout::COMPACT){
+    node->parentAndColour = reinterpret_cast<std::uintptr_t>(parentNode) |
+                            (node->parentAndColour & 1);
+  }
+  else{
+    node->parent = parentNode;
+  }
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+Colour RBTree<T, Layout, Hash>::colourOf(const Node* node) {
+  if constexpr (Layout == NodeLayout::COMPACT){
+    return (node->parentAndColour & 1) != 0 ? Colour::BLACK : Colour::RED;
+  }
+  else{
+    return node->colour;
+  }
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::setColour(Node* node, Colour colour) {
+  if constexpr (Layout == NodeLayout::COMPACT){
+    node->parentAndColour = (node->parentAndColour & ~std::uintptr_t(1)) |
+                            (colour == Colour::BLACK ? 1 : 0);
+  }
+  else{
+    node->colour = colour;
+  }
 }
+
+// The nilNode of every tree of this type. Sharing it lets a join hang one
+// tree's nodes below another's without rewriting their nil links. Trees on
+// other threads read it at the same time, so nothing ever writes to it.
+template <typename T, NodeLayout Layout, typename Hash>
+typename RBTree<T, Layout, Hash>::Node* RBTree<T, Layout, Hash>::sentinel() {
+  struct Sentinel {
+    Node node;
+    Sentinel() { setColour(&node, Colour::BLACK); }
+  };
+  static Sentinel nil;
+  return &nil.node;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+RBTree<T, Layout, Hash>::RBTree() {}
 /*
 Node* tmpNode = nullptr;
   static T tmp;
@@ -93,150 +527,354 @@ Node* tmpNode = nullptr;
   
   
 */
-template <typename T>
-RBTree<T>::~RBTree() {
-  Node* tmpNode = nullptr;
-  bool deleted = false;
-  while (root != NULL && root !=nilNode){
-    tmpNode= root;
-    while (tmpNode->leftChild != nilNode){
-      tmpNode = tmpNode->leftChild;
+template <typename T, NodeLayout Layout, typename Hash>
+RBTree<T, Layout, Hash>::~RBTree() {
+  clearNodes();
+}
+
+// Takes a slot from the pool and constructs a node with an element made
+// from args in it.
+template <typename T, NodeLayout Layout, typename Hash>
+template <typename... Args>
+typename RBTree<T, Layout, Hash>::Node* RBTree<T, Layout, Hash>::allocateNode(
+    Args&&... args) {
+  void* slot = pool.allocate();
+  Node* node = new (slot) Node;
+  try{
+    new (&node->element) T(std::forward<Args>(args)...);
+  }
+  catch (...){
+    node->~Node();
+    pool.deallocate(slot);
+    throw;
+  }
+  return node;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::freeNode(Node* node) {
+  node->element.~T();
+  node->~Node();
+  NodePool<Node>::deallocate(node);
+}
+
+// Moves node's element, links and colour into a new node from into. node
+// keeps its links and a moved-from element.
+template <typename T, NodeLayout Layout, typename Hash>
+typename RBTree<T, Layout, Hash>::Node* RBTree<T, Layout, Hash>::relocateNode(
+    Node* node, NodePool<Node>& into) {
+  Node* moved = new (into.allocate()) Node;
+  new (&moved->element) T(std::move(node->element));
+  moved->leftChild = node->leftChild;
+  moved->rightChild = node->rightChild;
+  setParent(moved, parentOf(node));
+  setColour(moved, colourOf(node));
+  moved->subtreeHeight = node->subtreeHeight;
+  if constexpr (HASHED){
+    moved->subtreeHash = node->subtreeHash;
+  }
+  return moved;
+}
+
+// Mixes the element's hash (splitmix64), so that the sums over subtrees of
+// nearby hashes, like those of consecutive integers, do not collide.
+template <typename T, NodeLayout Layout, typename Hash>
+std::uint64_t RBTree<T, Layout, Hash>::elementHash(const T& element) {
+  std::uint64_t x = static_cast<std::uint64_t>(Hash()(element)) +
+                    0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// Recomputes node's height, and its hash if the tree has a Hash, from its
+// children. A subtree's hash is the sum of its elements' hashes. Unlike a
+// hash over the shape, that is the same for equal sets of elements however
+// they were inserted, so subtrees of two trees can be matched by key range.
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::updateSubtree(Node* node) {
+  node->subtreeHeight = 1 + std::max(node->leftChild->subtreeHeight,
+                                     node->rightChild->subtreeHeight);
+  if constexpr (HASHED){
+    node->subtreeHash = node->leftChild->subtreeHash +
+                        elementHash(node->element) +
+                        node->rightChild->subtreeHash;
+  }
+}
+
+// Recomputes node, whose children or element changed, and the nodes above
+// it. Hashes change all the way up; without them the walk stops at the
+// first node whose height stays the same.
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::updateSubtreesUp(Node* node) {
+  if constexpr (HASHED){
+    for (; node != nilNode; node = parentOf(node)){
+      updateSubtree(node);
+    }
+  }
+  else{
+    updateHeightsUp(node);
+  }
+}
+
+// Recomputes the heights from node up, until one stays the same.
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::updateHeightsUp(Node* node) {
+  for (; node != nilNode; node = parentOf(node)){
+    std::uint8_t before = node->subtreeHeight;
+    node->subtreeHeight = 1 + std::max(node->leftChild->subtreeHeight,
+                                       node->rightChild->subtreeHeight);
+    if (node->subtreeHeight == before){
+      return;
+    }
+  }
+}
+
+// Moves node into a new slot from the pool and points its neighbours at the
+// copy.
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::moveNode(Node* node) {
+  Node* moved = relocateNode(node, pool);
+  Node* parentNode = parentOf(moved);
+  if (parentNode == nilNode){
+    root = moved;
+  }
+  else if (parentNode->leftChild == node){
+    parentNode->leftChild = moved;
+  }
+  else{
+    parentNode->rightChild = moved;
+  }
+  if (moved->leftChild != nilNode){
+    setParent(moved->leftChild, moved);
+  }
+  if (moved->rightChild != nilNode){
+    setParent(moved->rightChild, moved);
+  }
+  freeNode(node);
+}
+
+// Frees every node bottom-up through the parent links, without rebalancing
+// and without recursion.
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::clearNodes() {
+  Node* curr = root;
+  while (curr != nilNode){
+    if (curr->leftChild != nilNode){
+      curr = curr->leftChild;
     }
-    deleted = RBTree<T>::deleteNode(tmpNode->element);
-    if (root != NULL && root !=nilNode){
-      tmpNode= root;
-      while (tmpNode->leftChild != nilNode){
-        tmpNode = tmpNode->leftChild;
+    else if (curr->rightChild != nilNode){
+      curr = curr->rightChild;
+    }
+    else{
+      Node* parentNode = parentOf(curr);
+      if (parentNode != nilNode){
+        if (curr == parentNode->leftChild){
+          parentNode->leftChild = nilNode;
+        }
+        else{
+          parentNode->rightChild = nilNode;
+        }
       }
-      deleted = RBTree<T>::deleteNode(tmpNode->element);
+      freeNode(curr);
+      curr = parentNode;
     }
   }
-  tmpNode = NULL;
-  delete root;
+  root = nilNode;
+  nodeCount = 0;
+  blackHeight = 0;
 }
 
-template <typename T>
-void RBTree<T>::Left_Rotate(Node* GrandfatherNode){
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::Left_Rotate(Node* GrandfatherNode){
   Node* rotateNode = nullptr;
   rotateNode = GrandfatherNode->rightChild;
   GrandfatherNode->rightChild = rotateNode->leftChild;
   if (rotateNode->leftChild != nilNode){
-    rotateNode->leftChild->parent = GrandfatherNode;
+    setParent(rotateNode->leftChild, GrandfatherNode);
   }
-  rotateNode->parent = GrandfatherNode->parent;
-  if (GrandfatherNode->parent == nilNode){
+  setParent(rotateNode, parentOf(GrandfatherNode));
+  if (parentOf(GrandfatherNode) == nilNode){
     root = rotateNode;
   }
-  else if (GrandfatherNode == GrandfatherNode->parent->leftChild){
-    GrandfatherNode->parent->leftChild = rotateNode;
+  else if (GrandfatherNode == parentOf(GrandfatherNode)->leftChild){
+    parentOf(GrandfatherNode)->leftChild = rotateNode;
   }
   else{
-    GrandfatherNode->parent->rightChild = rotateNode;
+    parentOf(GrandfatherNode)->rightChild = rotateNode;
   }
   rotateNode->leftChild = GrandfatherNode;
-  GrandfatherNode->parent = rotateNode;
+  setParent(GrandfatherNode, rotateNode);
+  updateSubtree(GrandfatherNode);
+  updateSubtree(rotateNode);
+  // The rotation keeps the hash of the subtree but may change its height.
+  updateHeightsUp(parentOf(rotateNode));
   rotateNode = NULL;
 }
 
-template <typename T>
-void RBTree<T>::Right_Rotate(Node* TheNode2){
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::Right_Rotate(Node* TheNode2){
   Node* rotateNode = nullptr;
   rotateNode = TheNode2->leftChild;
   TheNode2->leftChild = rotateNode->rightChild;
   if (rotateNode->rightChild != nilNode){
-    rotateNode->rightChild->parent = TheNode2;
+    setParent(rotateNode->rightChild, TheNode2);
   }
-  rotateNode->parent = TheNode2->parent;
-  if (TheNode2->parent == nilNode){
+  setParent(rotateNode, parentOf(TheNode2));
+  if (parentOf(TheNode2) == nilNode){
     root = rotateNode;
   }
-  else if (TheNode2 == TheNode2->parent->rightChild){
-    TheNode2->parent->rightChild = rotateNode;
+  else if (TheNode2 == parentOf(TheNode2)->rightChild){
+    parentOf(TheNode2)->rightChild = rotateNode;
   }
   else{
-    TheNode2->parent->leftChild = rotateNode;
+    parentOf(TheNode2)->leftChild = rotateNode;
   }
   rotateNode->rightChild = TheNode2;
-  TheNode2->parent = rotateNode;
+  setParent(TheNode2, rotateNode);
+  updateSubtree(TheNode2);
+  updateSubtree(rotateNode);
+  updateHeightsUp(parentOf(rotateNode));
   rotateNode = NULL;
 }
 
-template <typename T>
-void RBTree<T>::RB_Insert_Fixup(Node* TheNode){
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::RB_Insert_Fixup(Node* TheNode){
   Node* fixNode = nullptr;
-  while (TheNode->parent->colour == Colour::RED){
-    if (TheNode->parent == TheNode->parent->parent->rightChild){
-      fixNode = TheNode->parent->parent->leftChild;
-      if (fixNode->colour == Colour::RED){
-        TheNode->parent->colour = Colour::BLACK;
-        fixNode->colour = Colour::BLACK;
-        TheNode->parent->parent->colour = Colour::RED;
-        TheNode = TheNode->parent->parent;
+  while (colourOf(parentOf(TheNode)) == Colour::RED){
+    if (parentOf(TheNode) == parentOf(parentOf(TheNode))->rightChild){
+      fixNode = parentOf(parentOf(TheNode))->leftChild;
+      if (colourOf(fixNode) == Colour::RED){
+        setColour(parentOf(TheNode), Colour::BLACK);
+        setColour(fixNode, Colour::BLACK);
+        setColour(parentOf(parentOf(TheNode)), Colour::RED);
+        TheNode = parentOf(parentOf(TheNode));
       }
       else{
-        if (TheNode == TheNode->parent->leftChild){
-          TheNode = TheNode->parent;
+        if (TheNode == parentOf(TheNode)->leftChild){
+          TheNode = parentOf(TheNode);
           Right_Rotate(TheNode);
         }
-        TheNode->parent->colour = Colour::BLACK;
-        TheNode->parent->parent->colour = Colour::RED;
-        Left_Rotate(TheNode->parent->parent);
+        setColour(parentOf(TheNode), Colour::BLACK);
+        setColour(parentOf(parentOf(TheNode)), Colour::RED);
+        Left_Rotate(parentOf(parentOf(TheNode)));
         }
     }
     else{
-      fixNode = TheNode->parent->parent->rightChild;
-      if (fixNode->colour == Colour::RED){
-        TheNode->parent->colour = Colour::BLACK;
-        fixNode->colour = Colour::BLACK;
-        TheNode->parent->parent->colour = Colour::RED;
-        TheNode = TheNode->parent->parent;
+      fixNode = parentOf(parentOf(TheNode))->rightChild;
+      if (colourOf(fixNode) == Colour::RED){
+        setColour(parentOf(TheNode), Colour::BLACK);
+        setColour(fixNode, Colour::BLACK);
+        setColour(parentOf(parentOf(TheNode)), Colour::RED);
+        TheNode = parentOf(parentOf(TheNode));
       }
       else{
-        if (TheNode == TheNode->parent->rightChild){
-          TheNode = TheNode->parent;
+        if (TheNode == parentOf(TheNode)->rightChild){
+          TheNode = parentOf(TheNode);
           Left_Rotate(TheNode);
         }
-        TheNode->parent->colour = Colour::BLACK;
-        TheNode->parent->parent->colour = Colour::RED;
-        Right_Rotate(TheNode->parent->parent);
+        setColour(parentOf(TheNode), Colour::BLACK);
+        setColour(parentOf(parentOf(TheNode)), Colour::RED);
+        Right_Rotate(parentOf(parentOf(TheNode)));
       }
       if (TheNode == root){
         break;
       }
     }
   }
-  root->colour = Colour::BLACK;
+  if (colourOf(root) == Colour::RED){
+    ++blackHeight;
+  }
+  setColour(root, Colour::BLACK);
   fixNode = NULL;
 }
 
-template <typename T>
-bool RBTree<T>::addNode(const T& element) {
-  if (RBTree<T>::find(element)){
+template <typename T, NodeLayout Layout, typename Hash>
+bool RBTree<T, Layout, Hash>::addNode(const T& element) {
+  return addElement(element);
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+bool RBTree<T, Layout, Hash>::addNode(T&& element) {
+  return addElement(std::move(element));
+}
+
+// Looks for the place first, so a duplicate is neither copied nor moved.
+template <typename T, NodeLayout Layout, typename Hash>
+template <typename U>
+bool RBTree<T, Layout, Hash>::addElement(U&& element) {
+  if (smallMode){
+    std::size_t i = smallLowerBound(element);
+    if (i < small.size() && !(element < small[i])){
+      return false;
+    }
+    if (small.size() < smallLimit){
+      small.insert(small.begin() + i, std::forward<U>(element));
+      ++nodeCount;
+      return true;
+    }
+    promote();
+  }
+  Node* y = nullptr;
+  if (!findInsertionParent(element, y)){
     return false;
   }
+  linkNode(allocateNode(std::forward<U>(element)), y);
+  return true;
+}
 
-  Node* newNode = new Node;
-  Node* x = nullptr;
+template <typename T, NodeLayout Layout, typename Hash>
+template <typename... Args>
+bool RBTree<T, Layout, Hash>::emplace(Args&&... args) {
+  if (smallMode){
+    return addElement(T(std::forward<Args>(args)...));
+  }
+  Node* newNode = allocateNode(std::forward<Args>(args)...);
   Node* y = nullptr;
-  x = root;
-  y = nilNode;
-  newNode->element = element;
-  newNode->rightChild = nilNode;
-  newNode->leftChild = nilNode;
+  if (!findInsertionParent(newNode->element, y)){
+    freeNode(newNode);
+    return false;
+  }
+  linkNode(newNode, y);
+  return true;
+}
 
+// Sets parentNode to the node below which element belongs, or returns false
+// if element is already in the tree.
+template <typename T, NodeLayout Layout, typename Hash>
+bool RBTree<T, Layout, Hash>::findInsertionParent(const T& element,
+                                                  Node*& parentNode) {
+  Node* x = root;
+  Node* y = nilNode;
   while (x != nilNode){
+    prefetchChildren(x);
     y = x;
-    if (newNode->element < x->element){
+    if (element < x->element){
       x = x->leftChild;
     }
-    else{
+    else if (x->element < element){
       x = x->rightChild;
     }
+    else{
+      return false;
+    }
   }
-  newNode->parent = y;
+  parentNode = y;
+  return true;
+}
+
+// Hangs newNode below y as a red leaf and rebalances.
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::linkNode(Node* newNode, Node* y) {
+  newNode->rightChild = nilNode;
+  newNode->leftChild = nilNode;
+  setParent(newNode, y);
+  setColour(newNode, Colour::RED);
+  ++nodeCount;
   if (y == nilNode){
-    newNode->colour = Colour::BLACK;
+    setColour(newNode, Colour::BLACK);
     root = newNode;
+    blackHeight = 1;
   }
   else if (newNode->element < y->element){
     y->leftChild = newNode;
@@ -244,330 +882,1667 @@ bool RBTree<T>::addNode(const T& element) {
   else{
     y->rightChild = newNode;
   }
+  updateSubtree(newNode);
+  updateSubtreesUp(y);
 
-  if (newNode->parent != nilNode){
-    if (newNode->parent->parent != nilNode){
-      RBTree<T>::RB_Insert_Fixup(newNode);
+  if (parentOf(newNode) != nilNode){
+    if (parentOf(parentOf(newNode)) != nilNode){
+      RBTree<T, Layout, Hash>::RB_Insert_Fixup(newNode);
     }
   }
   else{
-    newNode->colour = Colour::BLACK;
+    setColour(newNode, Colour::BLACK);
   }
-  x = NULL;
-  y = NULL;
   newNode = NULL;
-  return true;
 }
 
-template <typename T>
-void RBTree<T>::RB_Transplant(Node* node, Node* nodechild){
-  if (node->parent == nilNode){
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::RB_Transplant(Node* node, Node* nodechild){
+  if (parentOf(node) == nilNode){
     root = nodechild;
   }
-  else if (node == node->parent->leftChild){
-    node->parent->leftChild = nodechild;
+  else if (node == parentOf(node)->leftChild){
+    parentOf(node)->leftChild = nodechild;
   }
   else{
-    node->parent->rightChild = nodechild;
+    parentOf(node)->rightChild = nodechild;
+  }
+  if (nodechild != nilNode){
+    setParent(nodechild, parentOf(node));
   }
-  nodechild->parent = node->parent;
 }
 
-template <typename T>
-void RBTree<T>::RB_Delete_Fixup(Node* currentnode){
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::RB_Delete_Fixup(Node* currentnode,
+                                              Node* parentNode){
   Node* tmpNode = nullptr;
-  while (currentnode != root && currentnode->colour == Colour::BLACK){
-    if (currentnode == currentnode->parent->leftChild){
-      tmpNode = currentnode->parent->rightChild;
-      if (tmpNode->colour == Colour::RED){
-        tmpNode->colour = Colour::BLACK;
-        currentnode->parent->colour = Colour::RED;
-        Left_Rotate(currentnode->parent);
-        tmpNode = currentnode->parent->rightChild;
+  while (currentnode != root && colourOf(currentnode) == Colour::BLACK){
+    if (currentnode == parentNode->leftChild){
+      tmpNode = parentNode->rightChild;
+      if (colourOf(tmpNode) == Colour::RED){
+        setColour(tmpNode, Colour::BLACK);
+        setColour(parentNode, Colour::RED);
+        Left_Rotate(parentNode);
+        tmpNode = parentNode->rightChild;
       }
 
-      if (tmpNode->leftChild->colour == Colour::BLACK && tmpNode->rightChild->colour == Colour::BLACK){
-        tmpNode->colour = Colour::RED;
-        currentnode = currentnode->parent;
+      if (colourOf(tmpNode->leftChild) == Colour::BLACK && colourOf(tmpNode->rightChild) == Colour::BLACK){
+        setColour(tmpNode, Colour::RED);
+        currentnode = parentNode;
+        parentNode = parentOf(parentNode);
+        if (currentnode == root && colourOf(currentnode) == Colour::BLACK){
+          --blackHeight;
+        }
       }
       else{
-        if (tmpNode->rightChild->colour == Colour::BLACK){
-          tmpNode->leftChild->colour = Colour::BLACK;
-          tmpNode->colour = Colour::RED;
+        if (colourOf(tmpNode->rightChild) == Colour::BLACK){
+          setColour(tmpNode->leftChild, Colour::BLACK);
+          setColour(tmpNode, Colour::RED);
           Right_Rotate(tmpNode);
-          tmpNode = currentnode->parent->rightChild;
+          tmpNode = parentNode->rightChild;
         }
 
-        tmpNode->colour = currentnode->parent->colour;
-        currentnode->parent->colour = Colour::BLACK;
-        tmpNode->rightChild->colour = Colour::BLACK;
-        Left_Rotate(currentnode->parent);
+        setColour(tmpNode, colourOf(parentNode));
+        setColour(parentNode, Colour::BLACK);
+        setColour(tmpNode->rightChild, Colour::BLACK);
+        Left_Rotate(parentNode);
         currentnode = root;
       }
     }
     else{
-      tmpNode = currentnode->parent->leftChild;
-      if (tmpNode->colour == Colour::RED){
-        tmpNode->colour = Colour::BLACK;
-        currentnode->parent->colour = Colour::RED;
-        Right_Rotate(currentnode->parent);
-        tmpNode = currentnode->parent->leftChild;
+      tmpNode = parentNode->leftChild;
+      if (colourOf(tmpNode) == Colour::RED){
+        setColour(tmpNode, Colour::BLACK);
+        setColour(parentNode, Colour::RED);
+        Right_Rotate(parentNode);
+        tmpNode = parentNode->leftChild;
       }
 
-      if (tmpNode->leftChild->colour == Colour::BLACK && tmpNode->rightChild->colour == Colour::BLACK){
-        tmpNode->colour = Colour::RED;
-        currentnode = currentnode->parent;
+      if (colourOf(tmpNode->leftChild) == Colour::BLACK && colourOf(tmpNode->rightChild) == Colour::BLACK){
+        setColour(tmpNode, Colour::RED);
+        currentnode = parentNode;
+        parentNode = parentOf(parentNode);
+        if (currentnode == root && colourOf(currentnode) == Colour::BLACK){
+          --blackHeight;
+        }
       }
       else{
-        if (tmpNode->leftChild->colour == Colour::BLACK){
-          tmpNode->rightChild->colour = Colour::BLACK;
-          tmpNode->colour = Colour::RED;
+        if (colourOf(tmpNode->leftChild) == Colour::BLACK){
+          setColour(tmpNode->rightChild, Colour::BLACK);
+          setColour(tmpNode, Colour::RED);
           Left_Rotate(tmpNode);
-          tmpNode = currentnode->parent->leftChild;
+          tmpNode = parentNode->leftChild;
         }
 
-        tmpNode->colour = currentnode->parent->colour;
-        currentnode->parent->colour = Colour::BLACK;
-        tmpNode->leftChild->colour = Colour::BLACK;
-        Right_Rotate(currentnode->parent);
+        setColour(tmpNode, colourOf(parentNode));
+        setColour(parentNode, Colour::BLACK);
+        setColour(tmpNode->leftChild, Colour::BLACK);
+        Right_Rotate(parentNode);
         currentnode = root;
       }
     }
   }
-  currentnode->colour = Colour::BLACK;
+  if (currentnode != nilNode){
+    setColour(currentnode, Colour::BLACK);
+  }
   tmpNode = NULL;
 }
 
-template <typename T>
-bool RBTree<T>::deleteNode(const T& element) {
-  Node* tmpNode = nullptr;
-  tmpNode = root;
-  bool findnode = false;
-  if (tmpNode == nilNode || tmpNode == NULL){
-    return false;
-  }
-  
-  while (((tmpNode->rightChild != nilNode) || (tmpNode->leftChild != nilNode)) && !findnode){
-    if (element == tmpNode->element){
-      findnode = true;
+template <typename T, NodeLayout Layout, typename Hash>
+bool RBTree<T, Layout, Hash>::deleteNode(const T& element) {
+  if (smallMode){
+    std::size_t i = smallLowerBound(element);
+    if (i == small.size() || element < small[i]){
+      return false;
     }
-    else if (element < tmpNode->element){
+    small.erase(small.begin() + i);
+    --nodeCount;
+    return true;
+  }
+  Node* tmpNode = root;
+  while (tmpNode != nilNode && !(element == tmpNode->element)){
+    prefetchChildren(tmpNode);
+    if (element < tmpNode->element){
       tmpNode = tmpNode->leftChild;
     }
-    else if (element > tmpNode->element){
+    else{
       tmpNode = tmpNode->rightChild;
     }
   }
-  if (element == tmpNode->element){
-    findnode = true;
-  }
-  if (!findnode){
+  if (tmpNode == nilNode){
     return false;
   }
+  unlinkNode(tmpNode);
+  freeNode(tmpNode);
+  if (nodeCount <= smallLimit / 2){
+    demote();
+  }
+  return true;
+}
+
+// Takes tmpNode out of the tree and rebalances, leaving tmpNode itself
+// untouched.
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::unlinkNode(Node* tmpNode) {
   Node* tmpNode2 = nullptr;
   Node* tmpNode3 = nullptr;
+  // tmpNode2's parent, kept here as tmpNode2 may be the shared nilNode.
+  Node* tmpNode2Parent = parentOf(tmpNode);
   tmpNode3 = tmpNode;
-  Colour tmpNode3_orig_colour = tmpNode3->colour;
+  Colour tmpNode3_orig_colour = colourOf(tmpNode3);
   if (tmpNode->leftChild == nilNode){
     tmpNode2 = tmpNode->rightChild;
-    RBTree<T>::RB_Transplant(tmpNode, tmpNode->rightChild);
+    RBTree<T, Layout, Hash>::RB_Transplant(tmpNode, tmpNode->rightChild);
   }
   else if (tmpNode->rightChild == nilNode){
     tmpNode2 = tmpNode->leftChild;
-    RBTree<T>::RB_Transplant(tmpNode, tmpNode->leftChild);
+    RBTree<T, Layout, Hash>::RB_Transplant(tmpNode, tmpNode->leftChild);
   }
   else{
     tmpNode3 = tmpNode->rightChild;
     while (tmpNode3->leftChild != nilNode){
       tmpNode3 = tmpNode3->leftChild;
     }
-    tmpNode3_orig_colour = tmpNode3->colour;
+    tmpNode3_orig_colour = colourOf(tmpNode3);
     tmpNode2 = tmpNode3->rightChild;
-    if (tmpNode3->parent == tmpNode){
-      tmpNode2->parent = tmpNode3;
+    if (parentOf(tmpNode3) == tmpNode){
+      tmpNode2Parent = tmpNode3;
     }
     else{
-      RBTree<T>::RB_Transplant(tmpNode3, tmpNode3->rightChild);
+      tmpNode2Parent = parentOf(tmpNode3);
+      RBTree<T, Layout, Hash>::RB_Transplant(tmpNode3, tmpNode3->rightChild);
       tmpNode3->rightChild = tmpNode->rightChild;
-      tmpNode3->rightChild->parent = tmpNode3;
+      setParent(tmpNode3->rightChild, tmpNode3);
     }
-    RBTree<T>::RB_Transplant(tmpNode, tmpNode3);
+    RBTree<T, Layout, Hash>::RB_Transplant(tmpNode, tmpNode3);
     tmpNode3->leftChild = tmpNode->leftChild;
-    tmpNode3->leftChild->parent = tmpNode3;
-    tmpNode3->colour = tmpNode->colour;
+    setParent(tmpNode3->leftChild, tmpNode3);
+    setColour(tmpNode3, colourOf(tmpNode));
+    // What the nodes above assume, so the walk below may stop short of it.
+    tmpNode3->subtreeHeight = tmpNode->subtreeHeight;
   }
-  delete tmpNode;
+  --nodeCount;
+  updateSubtreesUp(tmpNode2Parent);
   if (tmpNode3_orig_colour == Colour::BLACK){
-    RBTree<T>::RB_Delete_Fixup(tmpNode2);
+    RBTree<T, Layout, Hash>::RB_Delete_Fixup(tmpNode2, tmpNode2Parent);
+  }
+  if (root == nilNode){
+    blackHeight = 0;
   }
   tmpNode2 = NULL;
   tmpNode3 = NULL;
-  return true;
 }
 
-template <typename T>
-bool RBTree<T>::findrec(Node* currnode, const T& element){
-  bool tmpbool = false;
-  if (currnode == nilNode){
-    return false;
+template <typename T, NodeLayout Layout, typename Hash>
+typename RBTree<T, Layout, Hash>::Node* RBTree<T, Layout, Hash>::findNode(
+    const T& element) {
+  Node* currnode = root;
+  while (currnode != nilNode){
+    prefetchChildren(currnode);
+    if (element < currnode->element){
+      currnode = currnode->leftChild;
+    }
+    else if (currnode->element < element){
+      currnode = currnode->rightChild;
+    }
+    else{
+      return currnode;
+    }
   }
-  if (element == currnode->element){
-    return true;
+  return nilNode;
+}
+
+// The node is lent out of this tree's pool, so that compaction leaves it
+// alone while it is in a handle or in another tree.
+template <typename T, NodeLayout Layout, typename Hash>
+typename RBTree<T, Layout, Hash>::NodeHandle RBTree<T, Layout, Hash>::extract(
+    const T& element) {
+  if (smallMode){
+    std::size_t i = smallLowerBound(element);
+    if (i == small.size() || element < small[i]){
+      return NodeHandle();
+    }
+    Node* node = allocateNode(std::move(small[i]));
+    small.erase(small.begin() + i);
+    --nodeCount;
+    pool.lend(node);
+    return NodeHandle(node);
   }
-  if (element < currnode->element){
-    tmpbool = findrec(currnode->leftChild, element);
-    return tmpbool;
+  Node* node = findNode(element);
+  if (node == nilNode){
+    return NodeHandle();
   }
-  
-  tmpbool = findrec(currnode->rightChild, element);
-  return tmpbool;
+  unlinkNode(node);
+  pool.lend(node);
+  if (nodeCount <= smallLimit / 2){
+    demote();
+  }
+  return NodeHandle(node);
 }
 
-template <typename T>
-bool RBTree<T>::find(const T& element) {
-  bool found = false;
-  found = findrec(root, element);
-  return found;
+template <typename T, NodeLayout Layout, typename Hash>
+bool RBTree<T, Layout, Hash>::insert(NodeHandle&& handle) {
+  Node* node = handle.node;
+  if (node == nullptr){
+    return false;
+  }
+  if (smallMode){
+    std::size_t i = smallLowerBound(node->element);
+    if (i < small.size() && !(node->element < small[i])){
+      return false;
+    }
+    if (small.size() < smallLimit){
+      small.insert(small.begin() + i, std::move(node->element));
+      ++nodeCount;
+      handle.reset();
+      return true;
+    }
+    promote();
+  }
+  Node* parentNode = nullptr;
+  if (!findInsertionParent(node->element, parentNode)){
+    return false;
+  }
+  handle.node = nullptr;
+  pool.adopt(node);
+  linkNode(node, parentNode);
+  return true;
 }
 
-template <typename T>
-const T& RBTree<T>::min() {
-  // Replace with proper implementation
-  Node* tmpNode = nullptr;
-  static T tmp;
-  if (root == nilNode){
-    throw std::string("The tree is empty");
+// other's slabs become this pool's, so compaction of this tree also moves
+// the nodes that came from other. Elements left in other are lent back out.
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::merge(RBTree& other) {
+  if (&other == this || other.nodeCount == 0){
+    return;
   }
-  
-  tmpNode= root;
-  while (tmpNode->leftChild != nilNode){
-    tmpNode = tmpNode->leftChild;
+  promote();
+  other.promote();
+  pool.absorb(other.pool);
+  if (root == nilNode ||
+      treeMaximum(root)->element < other.treeMinimum(other.root)->element){
+    joinAbove(other);
+  }
+  else if (other.treeMaximum(other.root)->element <
+           treeMinimum(root)->element){
+    swapNodes(other);
+    joinAbove(other);
+  }
+  else{
+    mergeOverlapping(other);
+  }
+  if (other.nodeCount <= other.smallLimit / 2){
+    other.demote();
   }
-  tmp = tmpNode->element;
-  tmpNode = NULL;
-  return tmp;
 }
 
-template <typename T>
-const T& RBTree<T>::max() {
-  // Replace with proper implementation
-  Node* tmpNode = nullptr;
-  static T tmp;
+// Exchanges the node trees, but not the pools.
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::swapNodes(RBTree& other) {
+  std::swap(root, other.root);
+  std::swap(nodeCount, other.nodeCount);
+  std::swap(blackHeight, other.blackHeight);
+}
+
+// Moves all of other into this tree, given that every element of other is
+// greater than every element of this tree. other's minimum is the pivot of
+// the join. Both trees share nilNode, so only the spine down to where
+// other is hung is visited, in O(log n).
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::joinAbove(RBTree& other) {
   if (root == nilNode){
-    throw std::string("The tree is empty");
+    swapNodes(other);
+    return;
   }
-  tmpNode= root;
-  while (tmpNode->rightChild != nilNode){
-    tmpNode = tmpNode->rightChild;
+  Node* pivot = other.treeMinimum(other.root);
+  other.unlinkNode(pivot);
+  if (other.root == other.nilNode){
+    linkNode(pivot, treeMaximum(root));
+    return;
   }
-  tmp = tmpNode->element;
-  tmpNode = NULL;
-  return tmp;
+  joinSubtrees({root, blackHeight}, pivot, {other.root, other.blackHeight});
+  nodeCount += other.nodeCount + 1;
+  other.root = other.nilNode;
+  other.nodeCount = 0;
+  other.blackHeight = 0;
 }
 
-template <typename T>
-std::vector<T> RBTree<T>::inOrder() {
-  std::vector<T> order = {};
-  RBTree<T>::inOrderRec(root, order);
-  return order;
+// Links left, pivot and right, which must be in ascending order, detached
+// and hang off nilNode, into one tree that becomes root (CLRS problem
+// 13-2). pivot is hung red in place of the rightmost black node of left
+// whose black height matches right's, with that node and right as its
+// children (or the mirror image if right is taller), and one insert fixup
+// restores the colours. Only the spine down to that node is visited.
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::joinSubtrees(Subtree left, Node* pivot,
+                                           Subtree right) {
+  // The fixup expects a black root above any red node it meets.
+  for (Subtree* part : {&left, &right}){
+    if (colourOf(part->top) == Colour::RED){
+      setColour(part->top, Colour::BLACK);
+      ++part->blackHeight;
+    }
+  }
+  bool intoLeft = left.blackHeight >= right.blackHeight;
+  const Subtree& taller = intoLeft ? left : right;
+  int target = intoLeft ? right.blackHeight : left.blackHeight;
+  Node* parentNode = nilNode;
+  Node* y = taller.top;
+  int h = taller.blackHeight;
+  while (colourOf(y) == Colour::RED || h > target){
+    if (colourOf(y) == Colour::BLACK){
+      --h;
+    }
+    parentNode = y;
+    y = intoLeft ? y->rightChild : y->leftChild;
+  }
+  pivot->leftChild = intoLeft ? y : left.top;
+  pivot->rightChild = intoLeft ? right.top : y;
+  setParent(pivot, parentNode);
+  if (parentNode == nilNode){
+    root = pivot;
+  }
+  else{
+    root = taller.top;
+    if (intoLeft){
+      parentNode->rightChild = pivot;
+    }
+    else{
+      parentNode->leftChild = pivot;
+    }
+  }
+  if (pivot->leftChild != nilNode){
+    setParent(pivot->leftChild, pivot);
+  }
+  if (pivot->rightChild != nilNode){
+    setParent(pivot->rightChild, pivot);
+  }
+  setColour(pivot, Colour::RED);
+  blackHeight = taller.blackHeight;
+  updateSubtree(pivot);
+  updateSubtreesUp(parentNode);
+  RB_Insert_Fixup(pivot);
 }
 
-template <typename T>
-void RBTree<T>::inOrderRec(Node* CurrNode, std::vector<T>& inOrderVec){
-  if (CurrNode != nilNode){
-    inOrderRec(CurrNode->leftChild, inOrderVec);
-    inOrderVec.push_back(CurrNode->element);
-    inOrderRec(CurrNode->rightChild, inOrderVec);
+// Splits the subtree below top, with black height topHeight, into the
+// elements less than element and the rest. top's children are split or
+// kept whole, and top joins the pieces on its side. The joins get cheaper
+// the further up they happen, and add up to O(log n).
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::splitSubtree(Node* top, int topHeight,
+                                           const T& element, Subtree& less,
+                                           Subtree& rest) {
+  if (top == nilNode){
+    less = {nilNode, 0};
+    rest = {nilNode, 0};
+    return;
+  }
+  int childHeight = topHeight - (colourOf(top) == Colour::BLACK ? 1 : 0);
+  Node* leftPart = top->leftChild;
+  Node* rightPart = top->rightChild;
+  if (leftPart != nilNode){
+    setParent(leftPart, nilNode);
+  }
+  if (rightPart != nilNode){
+    setParent(rightPart, nilNode);
+  }
+  if (top->element < element){
+    splitSubtree(rightPart, childHeight, element, less, rest);
+    joinSubtrees({leftPart, childHeight}, top, less);
+    less = {root, blackHeight};
+  }
+  else{
+    splitSubtree(leftPart, childHeight, element, less, rest);
+    joinSubtrees(rest, top, {rightPart, childHeight});
+    rest = {root, blackHeight};
   }
 }
 
-template <typename T>
-int RBTree<T>::heightRec(Node* CurrNode) {
-  if (CurrNode == nilNode){
-    return -1;
+// Frees every node below top and returns how many there were.
+template <typename T, NodeLayout Layout, typename Hash>
+std::size_t RBTree<T, Layout, Hash>::freeSubtree(Node* top) {
+  std::size_t freed = 0;
+  std::vector<Node*> pending;
+  if (top != nilNode){
+    pending.push_back(top);
   }
-  return (1+ std::max(heightRec(CurrNode->leftChild), (heightRec(CurrNode->rightChild))));
+  while (!pending.empty()){
+    Node* node = pending.back();
+    pending.pop_back();
+    if (node->leftChild != nilNode){
+      pending.push_back(node->leftChild);
+    }
+    if (node->rightChild != nilNode){
+      pending.push_back(node->rightChild);
+    }
+    freeNode(node);
+    ++freed;
+  }
+  return freed;
 }
 
-template <typename T>
-int RBTree<T>::height() {
-  int heigh = -1;
+template <typename T, NodeLayout Layout, typename Hash>
+std::size_t RBTree<T, Layout, Hash>::eraseRange(const T& lo, const T& hi) {
+  if (!(lo < hi)){
+    return 0;
+  }
+  if (smallMode){
+    auto first = small.begin() + smallLowerBound(lo);
+    auto last = small.begin() + smallLowerBound(hi);
+    std::size_t erased = last - first;
+    small.erase(first, last);
+    nodeCount -= erased;
+    return erased;
+  }
   if (root == nilNode){
-    return heigh;
+    return 0;
   }
-  
-  heigh = heightRec(root);
-  return heigh;
+  Subtree below;
+  Subtree from;
+  Subtree inside;
+  Subtree above;
+  splitSubtree(root, blackHeight, lo, below, from);
+  splitSubtree(from.top, from.blackHeight, hi, inside, above);
+  std::size_t erased = freeSubtree(inside.top);
+  nodeCount -= erased;
+  if (above.top == nilNode){
+    root = below.top;
+    blackHeight = below.blackHeight;
+    if (colourOf(root) == Colour::RED){
+      setColour(root, Colour::BLACK);
+      ++blackHeight;
+    }
+  }
+  else{
+    // The minimum of above is taken out of it to become the pivot.
+    root = above.top;
+    blackHeight = above.blackHeight;
+    if (colourOf(root) == Colour::RED){
+      setColour(root, Colour::BLACK);
+      ++blackHeight;
+    }
+    Node* pivot = treeMinimum(root);
+    unlinkNode(pivot);
+    ++nodeCount;
+    joinSubtrees(below, pivot, {root, blackHeight});
+  }
+  if (root == nilNode){
+    blackHeight = 0;
+  }
+  if (nodeCount <= smallLimit / 2){
+    demote();
+  }
+  return erased;
 }
 
-template <typename T>
-std::vector<T> RBTree<T>::pathFromRoot(const T& element) {
-  std::vector<T> result = {};
-  if (!static_cast<bool>(RBTree<T>::find(element))){
-    return result;
+template <typename T, NodeLayout Layout, typename Hash>
+template <typename F>
+std::size_t RBTree<T, Layout, Hash>::eraseIf(F pred) {
+  if (smallMode){
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < small.size(); ++i){
+      if (!pred(static_cast<const T&>(small[i]))){
+        if (kept != i){
+          small[kept] = std::move(small[i]);
+        }
+        ++kept;
+      }
+    }
+    std::size_t erased = small.size() - kept;
+    small.erase(small.begin() + kept, small.end());
+    nodeCount -= erased;
+    return erased;
   }
-  if (root->element == element){
-    result.push_back(root->element);
-    return result;
+  std::vector<Node*> kept;
+  std::vector<Node*> doomed;
+  kept.reserve(nodeCount);
+  for (Node* node = treeMinimum(root); node != nilNode;
+       node = successor(node)){
+    (pred(static_cast<const T&>(node->element)) ? doomed : kept)
+        .push_back(node);
   }
-  Node* tmpNode = nullptr;
-  tmpNode = root;
-  while ((tmpNode->rightChild != nilNode) || (tmpNode->leftChild != nilNode)){
-    if (element == tmpNode ->element){
-      tmpNode = NULL;
-      return result;
+  std::size_t depth = 0;
+  for (std::size_t n = nodeCount; n > 1; n >>= 1){
+    ++depth;
+  }
+  if (doomed.size() * depth < 4 * nodeCount){
+    for (Node* node : doomed){
+      unlinkNode(node);
+      freeNode(node);
     }
-    if (element < tmpNode->element){
-      result.push_back(tmpNode->element);
-      tmpNode = tmpNode->leftChild;
+  }
+  else{
+    for (Node* node : doomed){
+      freeNode(node);
     }
-    if (element > tmpNode->element){
-      result.push_back(tmpNode->element);
-      tmpNode = tmpNode->rightChild;
+    buildFromSortedNodes(kept);
+  }
+  if (nodeCount <= smallLimit / 2){
+    demote();
+  }
+  return doomed.size();
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+template <typename InputIt>
+std::size_t RBTree<T, Layout, Hash>::deleteBatch(InputIt first, InputIt last) {
+  std::vector<T> keys(first, last);
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end(),
+                         [](const T& a, const T& b) { return !(a < b); }),
+             keys.end());
+  if (smallMode || keys.size() * 4 >= nodeCount){
+    auto key = keys.begin();
+    return eraseIf([&](const T& element) {
+      while (key != keys.end() && *key < element){
+        ++key;
+      }
+      return key != keys.end() && !(element < *key);
+    });
+  }
+  // Sparse batches gain nothing from sharing the walk, so each key is
+  // deleted on its own, in key order so that nearby searches hit the cache.
+  if (keys.size() * 64 < nodeCount){
+    std::size_t erased = 0;
+    for (const T& key : keys){
+      erased += deleteNode(key);
     }
-    if (element == tmpNode->element){
-      tmpNode = NULL;
-      return result;
+    return erased;
+  }
+  // Every node is located before the first unlink, while the walk can
+  // still rely on the tree's shape. Only the lookups are shared; each node
+  // is then unlinked with its own fixup. Splitting off the span the keys
+  // cover and rebuilding it touches every node in the span, which costs
+  // about as much as these fixups, so it was not worth the extra code.
+  std::vector<Node*> doomed;
+  Node* curr = root;
+  for (const T& key : keys){
+    Node* node = findNext(key, curr);
+    if (node != nilNode){
+      doomed.push_back(node);
     }
   }
-  tmpNode = NULL;
-  return result;
+  for (Node* node : doomed){
+    unlinkNode(node);
+    freeNode(node);
+  }
+  if (nodeCount <= smallLimit / 2){
+    demote();
+  }
+  return doomed.size();
 }
 
-template <typename T>
-std::string RBTree<T>::ToGraphviz()  // Member function of the AVLTree class
-{
-  std::string toReturn = std::string("digraph {\n");
-  if (root != nullptr &&
-      root != nilNode)  // root is a pointer to the root node of the tree
-  {
-    std::string nodes;
-    std::string connections = "\t\"Root\" -> 0;\n";
-    GzAddNode(nodes, connections, root, 0);
-    toReturn += nodes;
-    toReturn += connections;
+// Each slab goes to the side that has most of its nodes, and the other
+// side's nodes in it are copied into slabs of its own. That copies at most
+// half of the nodes, and none if the two sides were allocated apart, but
+// leaves neither output with nodes it cannot compact nor this tree's pool
+// pinned by them.
+template <typename T, NodeLayout Layout, typename Hash>
+template <typename F>
+void RBTree<T, Layout, Hash>::partition(F pred, RBTree& matching,
+                                        RBTree& rest) {
+  if (&matching == this || &rest == this || &matching == &rest){
+    throw std::string("partition() needs two trees other than this one");
+  }
+  matching.clear();
+  rest.clear();
+  if (smallMode){
+    std::vector<bool> matches;
+    matches.reserve(small.size());
+    for (const T& element : small){
+      matches.push_back(pred(element));
+    }
+    for (std::size_t i = 0; i < small.size(); ++i){
+      (matches[i] ? matching : rest).small.push_back(std::move(small[i]));
+    }
+    small.clear();
+    nodeCount = 0;
+    for (RBTree* tree : {&matching, &rest}){
+      if (!tree->small.empty()){
+        tree->smallMode = true;
+        tree->nodeCount = tree->small.size();
+        if (tree->nodeCount > tree->smallLimit){
+          tree->promote();
+        }
+      }
+    }
+    return;
+  }
+  std::vector<Node*> yes;
+  std::vector<Node*> no;
+  for (Node* node = treeMinimum(root); node != nilNode;
+       node = successor(node)){
+    (pred(static_cast<const T&>(node->element)) ? yes : no).push_back(node);
+  }
+  matching.promote();
+  rest.promote();
+  pool.divide(yes, matching.pool, no, rest.pool);
+  for (RBTree* tree : {&matching, &rest}){
+    for (Node*& node : tree == &matching ? yes : no){
+      if (!tree->pool.owns(node)){
+        Node* moved = relocateNode(node, tree->pool);
+        freeNode(node);
+        node = moved;
+      }
+    }
+  }
+  matching.buildFromSortedNodes(yes);
+  rest.buildFromSortedNodes(no);
+  root = nilNode;
+  nodeCount = 0;
+  blackHeight = 0;
+  demote();
+  for (RBTree* tree : {&matching, &rest}){
+    if (tree->nodeCount <= tree->smallLimit / 2){
+      tree->demote();
+    }
+  }
+}
+
+// Inserts other's nodes one by one, unless other is about as large as this
+// tree. Then both node lists are merged and the tree rebuilt in linear time
+// instead; that touches every node several times in no particular memory
+// order, so it only wins over the descents, whose upper levels stay cached,
+// when there are many of them.
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::mergeOverlapping(RBTree& other) {
+  std::vector<Node*> theirs;
+  other.collectNodes(theirs);
+  other.root = other.nilNode;
+  std::vector<Node*> duplicates;
+  std::size_t depth = 0;
+  for (std::size_t n = nodeCount; n > 1; n >>= 1){
+    ++depth;
+  }
+  if (theirs.size() * depth < 4 * (nodeCount + theirs.size())){
+    for (Node* node : theirs){
+      Node* parentNode = nullptr;
+      if (findInsertionParent(node->element, parentNode)){
+        linkNode(node, parentNode);
+      }
+      else{
+        duplicates.push_back(node);
+      }
+    }
+  }
+  else{
+    std::vector<Node*> mine;
+    collectNodes(mine);
+    std::vector<Node*> merged;
+    merged.reserve(mine.size() + theirs.size());
+    auto a = mine.begin();
+    auto b = theirs.begin();
+    while (a != mine.end() && b != theirs.end()){
+      if ((*a)->element < (*b)->element){
+        merged.push_back(*a++);
+      }
+      else if ((*b)->element < (*a)->element){
+        merged.push_back(*b++);
+      }
+      else{
+        merged.push_back(*a++);
+        duplicates.push_back(*b++);
+      }
+    }
+    merged.insert(merged.end(), a, mine.end());
+    merged.insert(merged.end(), b, theirs.end());
+    buildFromSortedNodes(merged);
+  }
+  for (Node* node : duplicates){
+    pool.lend(node);
+  }
+  other.buildFromSortedNodes(duplicates);
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::collectNodes(std::vector<Node*>& nodes) {
+  nodes.reserve(nodes.size() + nodeCount);
+  for (Node* node = treeMinimum(root); node != nilNode;
+       node = successor(node)){
+    nodes.push_back(node);
+  }
+}
+
+// Links nodes, which must be sorted, into a balanced tree replacing the
+// current one without freeing it. Every level is full except perhaps the
+// last, whose nodes are red, so every path has the same number of black
+// nodes.
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::buildFromSortedNodes(
+    const std::vector<Node*>& nodes) {
+  int levels = fullLevels(nodes.size());
+  root = buildRange(nodes, 0, nodes.size(), nilNode, 0, levels);
+  nodeCount = nodes.size();
+  blackHeight = levels;
+}
+
+// The number of full levels in a balanced tree of count nodes, which is
+// also its black height as built by buildFromSortedNodes().
+template <typename T, NodeLayout Layout, typename Hash>
+int RBTree<T, Layout, Hash>::fullLevels(std::size_t count) {
+  int levels = 0;
+  while ((std::size_t(2) << levels) - 1 <= count){
+    ++levels;
+  }
+  return levels;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+typename RBTree<T, Layout, Hash>::Node* RBTree<T, Layout, Hash>::buildRange(
+    const std::vector<Node*>& nodes, std::size_t first, std::size_t last,
+    Node* parentNode, int depth, int redDepth) {
+  if (first == last){
+    return nilNode;
+  }
+  std::size_t middle = first + (last - first) / 2;
+  Node* node = nodes[middle];
+  setParent(node, parentNode);
+  setColour(node, depth == redDepth ? Colour::RED : Colour::BLACK);
+  node->leftChild = buildRange(nodes, first, middle, node, depth + 1,
+                               redDepth);
+  node->rightChild = buildRange(nodes, middle + 1, last, node, depth + 1,
+                                redDepth);
+  updateSubtree(node);
+  return node;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+bool RBTree<T, Layout, Hash>::rekey(const T& oldKey, const T& newKey) {
+  if (smallMode){
+    std::size_t i = smallLowerBound(oldKey);
+    if (i == small.size() || oldKey < small[i]){
+      return false;
+    }
+    std::size_t j = smallLowerBound(newKey);
+    if (j != i && j < small.size() && !(newKey < small[j])){
+      return false;
+    }
+    small[i] = newKey;
+    if (i < j){
+      std::rotate(small.begin() + i, small.begin() + i + 1, small.begin() + j);
+    }
+    else if (j < i){
+      std::rotate(small.begin() + j, small.begin() + i, small.begin() + i + 1);
+    }
+    return true;
+  }
+  Node* node = findNode(oldKey);
+  if (node == nilNode){
+    return false;
+  }
+  Node* before = predecessor(node);
+  Node* after = successor(node);
+  if ((before == nilNode || before->element < newKey) &&
+      (after == nilNode || newKey < after->element)){
+    node->element = newKey;
+    updateSubtreesUp(node);
+    return true;
+  }
+  // A taken newKey is rejected before the tree is touched. The insertion
+  // parent is only looked up after the unlink, whose rebalancing may move
+  // it.
+  if (findNode(newKey) != nilNode){
+    return false;
+  }
+  unlinkNode(node);
+  Node* parentNode = nullptr;
+  findInsertionParent(newKey, parentNode);
+  node->element = newKey;
+  linkNode(node, parentNode);
+  return true;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+bool RBTree<T, Layout, Hash>::find(const T& element) {
+  if (smallMode){
+    return smallFind(element);
+  }
+  Node* currnode = root;
+  while (currnode != nilNode){
+    prefetchChildren(currnode);
+    if (element < currnode->element){
+      currnode = currnode->leftChild;
+    }
+    else if (currnode->element < element){
+      currnode = currnode->rightChild;
+    }
+    else{
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+const T* RBTree<T, Layout, Hash>::findPtr(const T& element) {
+  return findElement(element);
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+T* RBTree<T, Layout, Hash>::findElement(const T& element) {
+  if (smallMode){
+    std::size_t i = smallLowerBound(element);
+    if (i == small.size() || element < small[i]){
+      return nullptr;
+    }
+    return &small[i];
+  }
+  Node* node = findNode(element);
+  return node == nilNode ? nullptr : &node->element;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+template <typename F>
+bool RBTree<T, Layout, Hash>::modify(const T& element, F fn) {
+  if (HASHED && !smallMode){
+    Node* node = findNode(element);
+    if (node == nilNode){
+      return false;
+    }
+    fn(node->element);
+    // fn may have changed what the element hashes to.
+    updateSubtreesUp(node);
+    return true;
+  }
+  T* stored = findElement(element);
+  if (stored == nullptr){
+    return false;
+  }
+  fn(*stored);
+  return true;
+}
+
+// Keeps up to LANES descents in flight. Each round moves every lane one
+// level down and prefetches the node it will compare against next round;
+// a lane that finishes is refilled with the next key straight away.
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::findBatch(const std::vector<T>& keys,
+                                        std::vector<bool>& out) {
+  constexpr std::size_t LANES = 16;
+  Node* cursor[LANES];
+  std::size_t keyIndex[LANES];
+  std::size_t next = 0;
+  std::size_t active = 0;
+  out.assign(keys.size(), false);
+  if (smallMode){
+    for (std::size_t i = 0; i < keys.size(); ++i){
+      out[i] = smallFind(keys[i]);
+    }
+    return;
+  }
+  while (active < LANES && next < keys.size()){
+    cursor[active] = root;
+    keyIndex[active++] = next++;
+  }
+  while (active > 0){
+    std::size_t lane = 0;
+    while (lane < active){
+      Node* node = cursor[lane];
+      const T& key = keys[keyIndex[lane]];
+      bool done = node == nilNode;
+      if (!done){
+        if (key < node->element){
+          node = node->leftChild;
+        }
+        else if (node->element < key){
+          node = node->rightChild;
+        }
+        else{
+          out[keyIndex[lane]] = true;
+          done = true;
+        }
+      }
+      if (!done){
+        prefetchNode(node);
+        cursor[lane++] = node;
+      }
+      else if (next < keys.size()){
+        cursor[lane] = root;
+        keyIndex[lane++] = next++;
+      }
+      else{
+        --active;
+        cursor[lane] = cursor[active];
+        keyIndex[lane] = keyIndex[active];
+      }
+    }
+  }
+}
+
+// Each lookup starts from the node where the previous one stopped. Keys
+// only grow, so the search climbs until it reaches a left child whose
+// parent is above the key: that subtree covers everything between the
+// previous key and the parent. From there it descends as usual.
+template <typename T, NodeLayout Layout, typename Hash>
+template <typename InputIt, typename OutputIt>
+OutputIt RBTree<T, Layout, Hash>::findSorted(InputIt first, InputIt last,
+                                             OutputIt out) {
+  if (smallMode){
+    for (; first != last; ++first){
+      *out = smallFind(*first);
+      ++out;
+    }
+    return out;
+  }
+  Node* curr = root;
+  for (; first != last; ++first){
+    *out = findNext(*first, curr) != nilNode;
+    ++out;
+  }
+  return out;
+}
+
+// Finds element starting from curr, the node where the previous search
+// stopped, whose key must not have been greater. Climbs only as far as
+// needed for element to be in curr's subtree, descends from there, and
+// leaves curr at the last node visited.
+template <typename T, NodeLayout Layout, typename Hash>
+typename RBTree<T, Layout, Hash>::Node* RBTree<T, Layout, Hash>::findNext(
+    const T& element, Node*& curr) const {
+  while (curr != root){
+    Node* parentNode = parentOf(curr);
+    if (curr == parentNode->leftChild && element < parentNode->element){
+      break;
+    }
+    curr = parentNode;
+  }
+  for (Node* node = curr; node != nilNode;){
+    curr = node;
+    if (element < node->element){
+      node = node->leftChild;
+    }
+    else if (node->element < element){
+      node = node->rightChild;
+    }
+    else{
+      return node;
+    }
+  }
+  return nilNode;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+bool RBTree<T, Layout, Hash>::operator==(const RBTree& other) const {
+  if (nodeCount != other.nodeCount){
+    return false;
+  }
+  Cursor mine(*this);
+  Cursor theirs(other);
+  for (; !mine.done(); mine.next(), theirs.next()){
+    if (*mine < *theirs || *theirs < *mine){
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+bool RBTree<T, Layout, Hash>::operator!=(const RBTree& other) const {
+  return !(*this == other);
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+int RBTree<T, Layout, Hash>::compare(const RBTree& other) const {
+  Cursor mine(*this);
+  Cursor theirs(other);
+  for (; !mine.done() && !theirs.done(); mine.next(), theirs.next()){
+    if (*mine < *theirs){
+      return -1;
+    }
+    if (*theirs < *mine){
+      return 1;
+    }
+  }
+  return static_cast<int>(!mine.done()) - static_cast<int>(!theirs.done());
+}
+
+#if defined(__cpp_impl_three_way_comparison)
+template <typename T, NodeLayout Layout, typename Hash>
+std::weak_ordering RBTree<T, Layout, Hash>::operator<=>(
+    const RBTree& other) const {
+  return compare(other) <=> 0;
+}
+#endif
+
+template <typename T, NodeLayout Layout, typename Hash>
+bool RBTree<T, Layout, Hash>::isSubsetOf(const RBTree& other) const {
+  if (nodeCount > other.nodeCount){
+    return false;
+  }
+  std::size_t depth = 0;
+  for (std::size_t n = other.nodeCount; n > 1; n >>= 1){
+    ++depth;
+  }
+  if (!other.smallMode && nodeCount * depth < other.nodeCount){
+    Node* curr = other.root;
+    for (Cursor mine(*this); !mine.done(); mine.next()){
+      if (other.findNext(*mine, curr) == other.nilNode){
+        return false;
+      }
+    }
+    return true;
+  }
+  Cursor theirs(other);
+  for (Cursor mine(*this); !mine.done(); mine.next()){
+    while (!theirs.done() && *theirs < *mine){
+      theirs.next();
+    }
+    if (theirs.done() || *mine < *theirs){
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+template <typename OutputIt>
+OutputIt RBTree<T, Layout, Hash>::diff(RBTree& other, OutputIt out) {
+  static_assert(HASHED, "diff() needs a tree with a Hash");
+  promote();
+  return diffSubtree(root, nullptr, nullptr, other, out);
+}
+
+// Diffs the subtree below node against the elements of other between lo
+// and hi, exclusive, where nullptr stands for no bound.
+template <typename T, NodeLayout Layout, typename Hash>
+template <typename OutputIt>
+OutputIt RBTree<T, Layout, Hash>::diffSubtree(Node* node, const T* lo,
+                                              const T* hi, RBTree& other,
+                                              OutputIt out) {
+  if (node == nilNode){
+    return other.copyRange(lo, hi, out);
+  }
+  std::uint64_t theirs = other.hashBelow(hi, false) -
+                         (lo == nullptr ? 0 : other.hashBelow(lo, true));
+  if (node->subtreeHash == theirs){
+    return out;
+  }
+  out = diffSubtree(node->leftChild, lo, &node->element, other, out);
+  const T* match = other.findPtr(node->element);
+  if (match == nullptr || elementHash(*match) != elementHash(node->element)){
+    *out = node->element;
+    ++out;
+  }
+  return diffSubtree(node->rightChild, &node->element, hi, other, out);
+}
+
+// The sum of the hashes of the elements less than bound, or not greater
+// if inclusive. nullptr stands for no bound.
+template <typename T, NodeLayout Layout, typename Hash>
+std::uint64_t RBTree<T, Layout, Hash>::hashBelow(const T* bound,
+                                                 bool inclusive) {
+  std::uint64_t sum = 0;
+  if (smallMode){
+    for (const T& element : small){
+      if (bound != nullptr &&
+          (inclusive ? *bound < element : !(element < *bound))){
+        break;
+      }
+      sum += elementHash(element);
+    }
+    return sum;
+  }
+  if (bound == nullptr){
+    return root->subtreeHash;
+  }
+  for (Node* node = root; node != nilNode;){
+    if (node->element < *bound || (inclusive && !(*bound < node->element))){
+      sum += node->leftChild->subtreeHash + elementHash(node->element);
+      node = node->rightChild;
+    }
+    else{
+      node = node->leftChild;
+    }
+  }
+  return sum;
+}
+
+// Writes the elements between lo and hi, exclusive, in ascending order.
+template <typename T, NodeLayout Layout, typename Hash>
+template <typename OutputIt>
+OutputIt RBTree<T, Layout, Hash>::copyRange(const T* lo, const T* hi,
+                                            OutputIt out) {
+  Cursor curr = lo == nullptr ? Cursor(*this) : Cursor(*this, *lo);
+  for (; !curr.done() && (hi == nullptr || *curr < *hi); curr.next()){
+    *out = *curr;
+    ++out;
+  }
+  return out;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::setPrefetch(Prefetch mode) {
+  prefetchMode = mode;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::setSmallLimit(std::size_t limit) {
+  smallLimit = limit;
+  if (smallMode && nodeCount > limit){
+    promote();
+  }
+  else if (!smallMode && nodeCount <= limit){
+    demote();
+  }
+}
+
+// Binary search whose comparison picks the next half without a branch, so
+// no mispredictions are paid on the few steps a small array needs.
+template <typename T, NodeLayout Layout, typename Hash>
+std::size_t RBTree<T, Layout, Hash>::smallLowerBound(const T& element) {
+  if (small.empty()){
+    return 0;
+  }
+  const T* base = small.data();
+  std::size_t n = small.size();
+  while (n > 1){
+    std::size_t half = n / 2;
+    base = (base[half] < element) ? base + half : base;
+    n -= half;
+  }
+  return (base - small.data()) + static_cast<std::size_t>(*base < element);
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+bool RBTree<T, Layout, Hash>::smallFind(const T& element) {
+  std::size_t i = smallLowerBound(element);
+  return i < small.size() && !(element < small[i]);
+}
+
+// Moves the elements from the sorted array into nodes. Every node is
+// allocated before any element moves, and elements whose move constructor
+// may throw are copied instead, so that if anything throws the array is
+// left as it was and the tree stays in small mode.
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::promote() {
+  if (!smallMode){
+    return;
+  }
+  std::vector<Node*> nodes;
+  nodes.reserve(small.size());
+  std::size_t constructed = 0;
+  try{
+    while (nodes.size() < small.size()){
+      nodes.push_back(new (pool.allocate()) Node);
+    }
+    for (; constructed < small.size(); ++constructed){
+      new (&nodes[constructed]->element)
+          T(std::move_if_noexcept(small[constructed]));
+    }
+  }
+  catch (...){
+    for (std::size_t i = 0; i < nodes.size(); ++i){
+      if (i < constructed){
+        nodes[i]->element.~T();
+      }
+      nodes[i]->~Node();
+      pool.deallocate(nodes[i]);
+    }
+    throw;
+  }
+  small = std::vector<T>();
+  smallMode = false;
+  buildFromSortedNodes(nodes);
+}
+
+// Moves the elements from the nodes into the sorted array and gives the
+// node slabs back.
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::demote() {
+  if (smallMode || smallLimit == 0){
+    return;
+  }
+  std::size_t count = nodeCount;
+  small = std::move(*this).inOrder();
+  pool = NodePool<Node>();
+  nodeCount = count;
+  smallMode = true;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::prefetchNode(const Node* node) {
+#if defined(__GNUC__)
+  __builtin_prefetch(node);
+#elif defined(_M_IX86) || defined(_M_X64)
+  _mm_prefetch(reinterpret_cast<const char*>(node), _MM_HINT_T0);
+#endif
+}
+
+// With GRANDCHILDREN the children were already requested one level up, so
+// reading their links is cheap and the grandchildren get a full level of
+// lead time. nil's links are nullptr, which is fine to prefetch.
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::prefetchChildren(const Node* node) {
+  if (prefetchMode == Prefetch::NONE){
+    return;
+  }
+  prefetchNode(node->leftChild);
+  prefetchNode(node->rightChild);
+  if (prefetchMode == Prefetch::GRANDCHILDREN){
+    prefetchNode(node->leftChild->leftChild);
+    prefetchNode(node->leftChild->rightChild);
+    prefetchNode(node->rightChild->leftChild);
+    prefetchNode(node->rightChild->rightChild);
+  }
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+const T& RBTree<T, Layout, Hash>::min() {
+  if (smallMode && !small.empty()){
+    return small.front();
+  }
+  Node* tmpNode = nullptr;
+  if (root == nilNode){
+    throw std::string("The tree is empty");
+  }
+  
+  tmpNode= root;
+  while (tmpNode->leftChild != nilNode){
+    tmpNode = tmpNode->leftChild;
+  }
+  return tmpNode->element;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+const T& RBTree<T, Layout, Hash>::max() {
+  if (smallMode && !small.empty()){
+    return small.back();
+  }
+  Node* tmpNode = nullptr;
+  if (root == nilNode){
+    throw std::string("The tree is empty");
+  }
+  tmpNode= root;
+  while (tmpNode->rightChild != nilNode){
+    tmpNode = tmpNode->rightChild;
+  }
+  return tmpNode->element;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+typename RBTree<T, Layout, Hash>::Node* RBTree<T, Layout, Hash>::treeMinimum(
+    Node* node) {
+  if (node == nilNode){
+    return nilNode;
+  }
+  while (node->leftChild != nilNode){
+    node = node->leftChild;
+  }
+  return node;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+typename RBTree<T, Layout, Hash>::Node* RBTree<T, Layout, Hash>::treeMaximum(
+    Node* node) {
+  if (node == nilNode){
+    return nilNode;
+  }
+  while (node->rightChild != nilNode){
+    node = node->rightChild;
+  }
+  return node;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+typename RBTree<T, Layout, Hash>::Node* RBTree<T, Layout, Hash>::successor(
+    Node* node) {
+  if (node->rightChild != nilNode){
+    return treeMinimum(node->rightChild);
+  }
+  Node* parentNode = parentOf(node);
+  while (parentNode != nilNode && node == parentNode->rightChild){
+    node = parentNode;
+    parentNode = parentOf(parentNode);
+  }
+  return parentNode;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+typename RBTree<T, Layout, Hash>::Node* RBTree<T, Layout, Hash>::predecessor(
+    Node* node) {
+  if (node->leftChild != nilNode){
+    return treeMaximum(node->leftChild);
+  }
+  Node* parentNode = parentOf(node);
+  while (parentNode != nilNode && node == parentNode->leftChild){
+    node = parentNode;
+    parentNode = parentOf(parentNode);
+  }
+  return parentNode;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+template <typename F>
+bool RBTree<T, Layout, Hash>::visit(F& fn, const T& element) {
+  if constexpr (std::is_void_v<std::invoke_result_t<F&, const T&>>){
+    fn(element);
+    return true;
+  }
+  else{
+    return static_cast<bool>(fn(element));
+  }
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+template <typename F>
+bool RBTree<T, Layout, Hash>::forEach(F fn) {
+  if (smallMode){
+    for (const T& element : small){
+      if (!visit(fn, element)){
+        return false;
+      }
+    }
+    return true;
+  }
+  for (Node* curr = treeMinimum(root); curr != nilNode; curr = successor(curr)){
+    if (!visit(fn, curr->element)){
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+template <typename F>
+bool RBTree<T, Layout, Hash>::forEachReverse(F fn) {
+  if (smallMode){
+    for (auto it = small.rbegin(); it != small.rend(); ++it){
+      if (!visit(fn, *it)){
+        return false;
+      }
+    }
+    return true;
+  }
+  for (Node* curr = treeMaximum(root); curr != nilNode;
+       curr = predecessor(curr)){
+    if (!visit(fn, curr->element)){
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+template <typename OutputIt>
+OutputIt RBTree<T, Layout, Hash>::inOrderInto(OutputIt out) {
+  if (smallMode){
+    return std::copy(small.begin(), small.end(), out);
+  }
+  for (Node* curr = treeMinimum(root); curr != nilNode; curr = successor(curr)){
+    *out = curr->element;
+    ++out;
+  }
+  return out;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+FrozenRBTree<T> RBTree<T, Layout, Hash>::freeze() {
+  return FrozenRBTree<T>(inOrder());
+}
+
+// Appends the top levels levels of the subtree at node in van Emde Boas
+// order: the upper half of those levels first, then each subtree hanging
+// below it from left to right, every part laid out the same way.
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::vebOrder(Node* node, int levels,
+                                       std::vector<Node*>& order) {
+  if (node == nilNode){
+    return;
+  }
+  if (levels == 1){
+    order.push_back(node);
+    return;
+  }
+  int top = levels / 2;
+  vebOrder(node, top, order);
+  vebOrderBelow(node, top, levels - top, order);
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::vebOrderBelow(Node* node, int depth, int levels,
+                                            std::vector<Node*>& order) {
+  if (node == nilNode){
+    return;
+  }
+  if (depth == 0){
+    vebOrder(node, levels, order);
+    return;
+  }
+  vebOrderBelow(node->leftChild, depth - 1, levels, order);
+  vebOrderBelow(node->rightChild, depth - 1, levels, order);
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::relayout() {
+  if (root == nilNode){
+    return;
+  }
+  std::vector<Node*> order;
+  order.reserve(nodeCount);
+  vebOrder(root, height() + 1, order);
+
+  // Copy each node into the new pool, then reuse the old node's leftChild
+  // to remember where it went so the copies' links can be redirected.
+  NodePool<Node> fresh;
+  for (Node* old : order){
+    old->leftChild = relocateNode(old, fresh);
+  }
+  auto forward = [this](Node* old) {
+    return old == nilNode ? nilNode : old->leftChild;
+  };
+  for (Node* old : order){
+    Node* moved = old->leftChild;
+    moved->leftChild = forward(moved->leftChild);
+    moved->rightChild = forward(moved->rightChild);
+    setParent(moved, forward(parentOf(moved)));
+  }
+  root = forward(root);
+  for (Node* old : order){
+    freeNode(old);
+  }
+  pool = std::move(fresh);
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+bool RBTree<T, Layout, Hash>::compactStep(std::size_t maxMoves) {
+  for (std::size_t moves = 0; moves < maxMoves;){
+    Node* node = static_cast<Node*>(pool.nextToEvacuate());
+    if (node != nullptr){
+      moveNode(node);
+      ++moves;
+    }
+    else if (!pool.beginEvacuation()){
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+bool RBTree<T, Layout, Hash>::compactFor(std::chrono::nanoseconds budget) {
+  // Small enough batches that a step overshoots the budget by microseconds.
+  const std::size_t BATCH = 64;
+  auto deadline = std::chrono::steady_clock::now() + budget;
+  do{
+    if (compactStep(BATCH)){
+      return true;
+    }
+  } while (std::chrono::steady_clock::now() < deadline);
+  return false;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+std::size_t RBTree<T, Layout, Hash>::slabCount() {
+  return pool.slabCount();
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+std::size_t RBTree<T, Layout, Hash>::size() {
+  return nodeCount;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+void RBTree<T, Layout, Hash>::clear() {
+  clearNodes();
+  small.clear();
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+std::vector<T> RBTree<T, Layout, Hash>::inOrder() & {
+  std::vector<T> order;
+  order.reserve(nodeCount);
+  inOrderInto(std::back_inserter(order));
+  return order;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+std::vector<T> RBTree<T, Layout, Hash>::inOrder() && {
+  if (smallMode){
+    std::vector<T> order;
+    order.swap(small);
+    nodeCount = 0;
+    return order;
+  }
+  std::vector<T> order;
+  order.reserve(nodeCount);
+  for (Node* curr = treeMinimum(root); curr != nilNode; curr = successor(curr)){
+    order.push_back(std::move(curr->element));
+  }
+  clearNodes();
+  return order;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+int RBTree<T, Layout, Hash>::height() {
+  if (smallMode){
+    // The balanced tree over n elements is floor(log2(n)) edges high.
+    int levels = -1;
+    for (std::size_t n = small.size(); n > 0; n >>= 1){
+      ++levels;
+    }
+    return levels;
+  }
+  return root->subtreeHeight - 1;
+}
+
+// Every root-to-nil path holds exactly blackHeight black nodes and no two
+// reds in a row, so the longest path is at most twice the shortest one.
+// Counted in edges, like height().
+template <typename T, NodeLayout Layout, typename Hash>
+std::pair<int, int> RBTree<T, Layout, Hash>::heightBounds() {
+  if (smallMode){
+    int levels = fullLevels(small.size());
+    return {levels - 1, 2 * levels - 1};
+  }
+  if (root == nilNode){
+    return {-1, -1};
+  }
+  return {blackHeight - 1, 2 * blackHeight - 1};
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+std::vector<T> RBTree<T, Layout, Hash>::pathFromRoot(const T& element) {
+  std::vector<T> result;
+  // A path never holds more nodes than the upper height bound plus one.
+  result.reserve(heightBounds().second + 1);
+  pathFromRoot(element, result);
+  return result;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+bool RBTree<T, Layout, Hash>::pathFromRoot(const T& element,
+                                           std::vector<T>& path) {
+  std::size_t start = path.size();
+  if (smallMode){
+    // Descends the balanced tree over the array; its root is the element
+    // reached before any ancestor was pushed.
+    std::size_t first = 0;
+    std::size_t last = small.size();
+    while (first < last){
+      std::size_t middle = first + (last - first) / 2;
+      if (element < small[middle]){
+        path.push_back(small[middle]);
+        last = middle;
+      }
+      else if (small[middle] < element){
+        path.push_back(small[middle]);
+        first = middle + 1;
+      }
+      else{
+        if (path.size() == start){
+          path.push_back(small[middle]);
+        }
+        return true;
+      }
+    }
+    path.erase(path.begin() + start, path.end());
+    return false;
+  }
+  Node* tmpNode = root;
+  while (tmpNode != nilNode){
+    if (element < tmpNode->element){
+      path.push_back(tmpNode->element);
+      tmpNode = tmpNode->leftChild;
+    }
+    else if (tmpNode->element < element){
+      path.push_back(tmpNode->element);
+      tmpNode = tmpNode->rightChild;
+    }
+    else{
+      if (tmpNode == root){
+        path.push_back(tmpNode->element);
+      }
+      return true;
+    }
+  }
+  path.erase(path.begin() + start, path.end());
+  return false;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
+std::string RBTree<T, Layout, Hash>::ToGraphviz()  // Member function of the AVLTree class
+{
+  std::string toReturn = std::string("digraph {\n");
+  if (smallMode && !small.empty()){
+    std::string nodes;
+    std::string connections = "\t\"Root\" -> 0;\n";
+    GzAddSmall(nodes, connections, 0, small.size(), 0,
+               fullLevels(small.size()), 0);
+    toReturn += nodes;
+    toReturn += connections;
+  }
+  else if (root != nullptr &&
+      root != nilNode)  // root is a pointer to the root node of the tree
+  {
+    std::string nodes;
+    std::string connections = "\t\"Root\" -> 0;\n";
+    GzAddNode(nodes, connections, root, 0);
+    toReturn += nodes;
+    toReturn += connections;
   }
   toReturn += "}";
   return toReturn;
 }
 
-template <typename T>
-int RBTree<T>::GzAddNode(std::string& nodes, std::string& connections,
-                         const Node* curr, size_t to) {
+template <typename T, NodeLayout Layout, typename Hash>
+int RBTree<T, Layout, Hash>::GzAddNode(std::string& nodes,
+                                       std::string& connections,
+                                       const Node* curr, size_t to) {
   size_t from = to;
   nodes += GzNode(from, curr->element, "filled",
-                  curr->colour == Colour::RED ? "tomato" : "black",
-                  curr->colour == Colour::RED ? "black" : "white");
+                  colourOf(curr) == Colour::RED ? "tomato" : "black",
+                  colourOf(curr) == Colour::RED ? "black" : "white");
 
   to = GzAddChild(nodes, connections, curr->leftChild, from, ++to, "blue");
   to = GzAddChild(nodes, connections, curr->rightChild, from, ++to, "gold");
   return to;
 }
 
-template <typename T>
-int RBTree<T>::GzAddChild(std::string& nodes, std::string& connections,
-                          const Node* child, size_t from, size_t to,
-                          const std::string& color) {
+template <typename T, NodeLayout Layout, typename Hash>
+int RBTree<T, Layout, Hash>::GzAddChild(std::string& nodes,
+                                        std::string& connections,
+                                        const Node* child, size_t from,
+                                        size_t to, const std::string& color) {
   if (child != nilNode) {
     connections += GzConnection(from, to, color, "");
     to = GzAddNode(nodes, connections, child, to);
@@ -575,15 +2550,46 @@ int RBTree<T>::GzAddChild(std::string& nodes, std::string& connections,
     nodes += GzNode(to, "null", "filled", "orange", "black");
     connections += GzConnection(from, to, "", "");
   } else {
-    nodes += GzNode(to, child->element, "invis", "", "");
+    // nilNode holds no element.
+    nodes += GzNode(to, "nil", "invis", "", "");
     connections += GzConnection(from, to, "", "invis");
   }
   return to;
 }
 
-template <typename T>
+// Like GzAddNode(), for the balanced tree promote() would build over
+// small[first, last).
+template <typename T, NodeLayout Layout, typename Hash>
+int RBTree<T, Layout, Hash>::GzAddSmall(std::string& nodes,
+                                        std::string& connections,
+                                        std::size_t first, std::size_t last,
+                                        int depth, int redDepth, size_t to) {
+  size_t from = to;
+  std::size_t middle = first + (last - first) / 2;
+  bool red = depth == redDepth;
+  nodes += GzNode(from, small[middle], "filled", red ? "tomato" : "black",
+                  red ? "black" : "white");
+  const std::pair<std::size_t, std::size_t> halves[] = {{first, middle},
+                                                        {middle + 1, last}};
+  const char* colors[] = {"blue", "gold"};
+  for (int side = 0; side < 2; ++side){
+    ++to;
+    if (halves[side].first == halves[side].second){
+      nodes += GzNode(to, "nil", "invis", "", "");
+      connections += GzConnection(from, to, "", "invis");
+    }
+    else{
+      connections += GzConnection(from, to, colors[side], "");
+      to = GzAddSmall(nodes, connections, halves[side].first,
+                      halves[side].second, depth + 1, redDepth, to);
+    }
+  }
+  return to;
+}
+
+template <typename T, NodeLayout Layout, typename Hash>
 template <typename V>
-std::string RBTree<T>::GzNode(size_t to, const V& what,
+std::string RBTree<T, Layout, Hash>::GzNode(size_t to, const V& what,
                               const std::string& style,
                               const std::string& fillColor,
                               const std::string& fontColor) {
@@ -592,8 +2598,8 @@ std::string RBTree<T>::GzNode(size_t to, const V& what,
       to, what, fillColor, fontColor, style);
 }
 
-template <typename T>
-std::string RBTree<T>::GzConnection(size_t from, size_t to,
+template <typename T, NodeLayout Layout, typename Hash>
+std::string RBTree<T, Layout, Hash>::GzConnection(size_t from, size_t to,
                                     const std::string& color,
                                     const std::string& style) {
   return fmt::format("\t{} -> {} [color=\"{}\" style=\"{}\"]\n", from, to,
@@ -0,0 +1,30 @@
+#include <cstdlib>
+
+#include "bench.hpp"
+#define FMT_HEADER_ONLY
+#include <fmt/format.h>
+
+// Usage: runbench [name] [max elements]
+int main(int argc, char* argv[]) {
+  std::string only = argc > 1 ? argv[1] : "";
+  std::size_t maxElements = argc > 2 ? std::strtoull(argv[2], nullptr, 10)
+                                     : std::size_t(1) << 20;
+  bool ran = false;
+  for (const Benchmark& benchmark : benchmarks()) {
+    if (only.empty() || only == "all" || only == benchmark.name) {
+      fmt::print("== {} (up to {} elements) ==\n", benchmark.name,
+                 maxElements);
+      benchmark.run(maxElements);
+      fmt::print("\n");
+      ran = true;
+    }
+  }
+  if (!ran) {
+    fmt::print("Unknown benchmark '{}', available:\n", only);
+    for (const Benchmark& benchmark : benchmarks()) {
+      fmt::print("  {}\n", benchmark.name);
+    }
+    return 1;
+  }
+  return 0;
+}
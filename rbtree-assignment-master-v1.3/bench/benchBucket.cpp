@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "BucketRBTree.hpp"
+#include "RBTree.hpp"
+#include "bench.hpp"
+
+namespace {
+
+template <typename Tree>
+void bucketRow(const std::string& name, const std::vector<int>& keys,
+               const std::vector<int>& probes) {
+  std::size_t before = heapInUse();
+  auto* rb = new Tree;
+  for (int key : keys) {
+    rb->addNode(key);
+  }
+  double bytesPerElement =
+      static_cast<double>(heapInUse() - before) / keys.size();
+  std::size_t hits = 0;
+  double findTime = timeIt([&] {
+    for (int key : probes) {
+      hits += rb->find(key);
+    }
+  });
+  long long sum = 0;
+  double scanTime = timeIt([&] { rb->forEach([&](int e) { sum += e; }); });
+  doNotOptimize(hits);
+  doNotOptimize(sum);
+  delete rb;
+  fmt::print("{:>10} {:<10} {:>16.1f} {:>10.2f} {:>10.2f}\n", keys.size(),
+             name, bytesPerElement, probes.size() / findTime / 1e6,
+             keys.size() / scanTime / 1e6);
+}
+
+// Memory, random lookups and in-order scans for one element per node
+// against buckets of 8, 16 and 32 elements.
+void benchBucket(std::size_t maxElements) {
+  auto shuffler = std::default_random_engine(42);
+  fmt::print("{:>10} {:<10} {:>16} {:>10} {:>10}   (M elems/s)\n", "size",
+             "tree", "heap bytes/elem", "find", "scan");
+  for (std::size_t n = 1000; n <= maxElements; n *= 10) {
+    std::vector<int> keys(n);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), shuffler);
+    std::vector<int> probes = keys;
+    std::shuffle(probes.begin(), probes.end(), shuffler);
+    bucketRow<RBTree<int>>("node", keys, probes);
+    bucketRow<BucketRBTree<int, 8>>("bucket8", keys, probes);
+    bucketRow<BucketRBTree<int, 16>>("bucket16", keys, probes);
+    bucketRow<BucketRBTree<int, 32>>("bucket32", keys, probes);
+  }
+}
+
+RegisterBenchmark bucket("bucket", &benchBucket);
+
+}  // namespace
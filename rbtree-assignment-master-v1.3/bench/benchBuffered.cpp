@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "BufferedRBTree.hpp"
+#include "RBTree.hpp"
+#include "bench.hpp"
+
+namespace {
+
+// Inserts n keys and then deletes every fourth one, and measures lookups
+// afterwards.
+template <typename Tree>
+void bufferedRow(const std::string& name, Tree& rb,
+                 const std::vector<int>& keys,
+                 const std::vector<int>& probes) {
+  double writeTime = timeIt([&] {
+    for (int key : keys) {
+      rb.addNode(key);
+    }
+    for (std::size_t i = 0; i < keys.size(); i += 4) {
+      rb.deleteNode(keys[i]);
+    }
+  });
+  std::size_t hits = 0;
+  double findTime = timeIt([&] {
+    for (int key : probes) {
+      hits += rb.find(key);
+    }
+  });
+  doNotOptimize(hits);
+  std::size_t writes = keys.size() + keys.size() / 4;
+  fmt::print("{:>10} {:<10} {:>10.2f} {:>10.2f}\n", keys.size(), name,
+             writes / writeTime / 1e6, probes.size() / findTime / 1e6);
+}
+
+// Write and lookup throughput of per-operation rebalancing against the
+// buffered tree.
+void benchBuffered(std::size_t maxElements) {
+  auto shuffler = std::default_random_engine(42);
+  fmt::print("{:>10} {:<10} {:>10} {:>10}   (M ops/s)\n", "size", "tree",
+             "writes", "find");
+  for (std::size_t n = 1000; n <= maxElements; n *= 10) {
+    std::vector<int> keys(n);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), shuffler);
+    std::vector<int> probes = keys;
+    std::shuffle(probes.begin(), probes.end(), shuffler);
+    RBTree<int> rb;
+    bufferedRow("rbtree", rb, keys, probes);
+    BufferedRBTree<int> buffered;
+    bufferedRow("buffered", buffered, keys, probes);
+  }
+}
+
+RegisterBenchmark buffered("buffered", &benchBuffered);
+
+}  // namespace
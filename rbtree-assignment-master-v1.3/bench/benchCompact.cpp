@@ -0,0 +1,50 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "RBTree.hpp"
+#include "bench.hpp"
+
+namespace {
+
+// Memory held after deleting 7 in 8 elements, before and after compacting,
+// and the longest single compaction step for a few move budgets.
+void benchCompact(std::size_t maxElements) {
+  auto shuffler = std::default_random_engine(42);
+  fmt::print("{:>10} {:>8} {:>12} {:>12} {:>8} {:>14}\n", "size", "budget",
+             "KiB deleted", "KiB compact", "steps", "max step us");
+  for (std::size_t n = 10000; n <= maxElements; n *= 10) {
+    for (std::size_t budget : {64, 256, 1024}) {
+      std::vector<int> keys(n);
+      std::iota(keys.begin(), keys.end(), 0);
+      std::shuffle(keys.begin(), keys.end(), shuffler);
+      std::size_t before = heapInUse();
+      auto* rb = new RBTree<int>;
+      for (int key : keys) {
+        rb->addNode(key);
+      }
+      for (std::size_t i = 0; i < n; ++i) {
+        if (i % 8 != 0) {
+          rb->deleteNode(keys[i]);
+        }
+      }
+      std::size_t deleted = heapInUse() - before;
+      std::size_t steps = 0;
+      double longest = 0;
+      bool done = false;
+      while (!done) {
+        longest = std::max(longest,
+                           timeIt([&] { done = rb->compactStep(budget); }));
+        ++steps;
+      }
+      std::size_t compacted = heapInUse() - before;
+      delete rb;
+      fmt::print("{:>10} {:>8} {:>12} {:>12} {:>8} {:>14.1f}\n", n, budget,
+                 deleted / 1024, compacted / 1024, steps, longest * 1e6);
+    }
+  }
+}
+
+RegisterBenchmark compact("compact", &benchCompact);
+
+}  // namespace
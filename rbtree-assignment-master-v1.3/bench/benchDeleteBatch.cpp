@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "RBTree.hpp"
+#include "bench.hpp"
+
+namespace {
+
+void fill(RBTree<int>& rb, const std::vector<int>& keys) {
+  for (int key : keys) {
+    rb.addNode(key);
+  }
+}
+
+void deleteBatchRow(std::size_t elements, std::size_t batchSize) {
+  auto shuffler = std::default_random_engine(42);
+  std::vector<int> keys(elements);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), shuffler);
+  std::vector<int> batch(keys.begin(), keys.begin() + batchSize);
+  std::shuffle(keys.begin(), keys.end(), shuffler);
+
+  RBTree<int> looped;
+  fill(looped, keys);
+  double loopTime = timeIt([&] {
+    for (int key : batch) {
+      looped.deleteNode(key);
+    }
+  });
+  RBTree<int> batched;
+  fill(batched, keys);
+  double batchTime =
+      timeIt([&] { batched.deleteBatch(batch.begin(), batch.end()); });
+  doNotOptimize(looped.size() + batched.size());
+  fmt::print("{:>9} {:>9} {:>10.3f} {:>10.3f}\n", elements, batchSize,
+             loopTime * 1e3, batchTime * 1e3);
+}
+
+// Deleting an unsorted batch of keys with one deleteNode() each versus
+// deleteBatch().
+void benchDeleteBatch(std::size_t maxElements) {
+  fmt::print("{:>9} {:>9} {:>10} {:>10}   (ms)\n", "elements", "batch", "loop",
+             "batch");
+  for (std::size_t elements = 10000; elements <= maxElements; elements *= 10) {
+    for (std::size_t batchSize = elements / 1000; batchSize <= elements / 2;
+         batchSize *= 5) {
+      deleteBatchRow(elements, batchSize);
+    }
+  }
+}
+
+RegisterBenchmark deleteBatch("deletebatch", &benchDeleteBatch);
+
+}  // namespace
@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "RBTree.hpp"
+#include "bench.hpp"
+
+namespace {
+
+using HashedTree = RBTree<int, NodeLayout::STANDARD, std::hash<int>>;
+
+void fill(HashedTree& rb, std::vector<int> keys, unsigned seed) {
+  std::shuffle(keys.begin(), keys.end(), std::default_random_engine(seed));
+  for (int key : keys) {
+    rb.addNode(key);
+  }
+}
+
+void diffRow(std::size_t elements, std::size_t changes) {
+  std::vector<int> keys(elements);
+  std::iota(keys.begin(), keys.end(), 0);
+  HashedTree a;
+  HashedTree b;
+  fill(a, keys, 1);
+  fill(b, keys, 2);
+  std::default_random_engine gen(3);
+  std::uniform_int_distribution<int> pick(0, static_cast<int>(elements) - 1);
+  for (std::size_t c = 0; c < changes; ++c) {
+    b.deleteNode(pick(gen));
+  }
+
+  std::vector<int> walked;
+  double walkTime = timeIt([&] {
+    std::vector<int> mine = a.inOrder();
+    std::vector<int> theirs = b.inOrder();
+    std::set_symmetric_difference(mine.begin(), mine.end(), theirs.begin(),
+                                  theirs.end(), std::back_inserter(walked));
+  });
+  std::vector<int> diffed;
+  double diffTime = timeIt([&] { a.diff(b, std::back_inserter(diffed)); });
+  doNotOptimize(walked.size() + diffed.size());
+  fmt::print("{:>9} {:>8} {:>10.3f} {:>10.3f}\n", elements, changes,
+             walkTime * 1e3, diffTime * 1e3);
+}
+
+// Finding what differs between two replicas inserted in different orders,
+// by comparing both inOrder() vectors versus diff().
+void benchDiff(std::size_t maxElements) {
+  fmt::print("{:>9} {:>8} {:>10} {:>10}   (ms)\n", "elements", "changes",
+             "walk", "diff");
+  for (std::size_t elements = 10000; elements <= maxElements; elements *= 10) {
+    for (std::size_t changes : {1, 100, 10000}) {
+      if (changes < elements) {
+        diffRow(elements, changes);
+      }
+    }
+  }
+}
+
+RegisterBenchmark diff("diff", &benchDiff);
+
+}  // namespace
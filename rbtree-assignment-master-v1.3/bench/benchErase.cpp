@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "RBTree.hpp"
+#include "bench.hpp"
+
+namespace {
+
+void fill(RBTree<int>& rb, std::size_t elements) {
+  auto shuffler = std::default_random_engine(42);
+  std::vector<int> keys(elements);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), shuffler);
+  for (int key : keys) {
+    rb.addNode(key);
+  }
+}
+
+// Erasing a share of the elements one deleteNode() at a time, versus
+// eraseRange() for the oldest keys and eraseIf() for scattered ones. The
+// scattered loop first has to find its keys with forEach(), as eraseIf()
+// does.
+void eraseRow(std::size_t elements, int percent) {
+  int cutoff = static_cast<int>(elements * percent / 100);
+  auto scatter = [percent](int key) { return key * 37 % 100 < percent; };
+
+  RBTree<int> looped;
+  fill(looped, elements);
+  double loopTime = timeIt([&] {
+    for (int key = 0; key < cutoff; ++key) {
+      looped.deleteNode(key);
+    }
+  });
+  RBTree<int> ranged;
+  fill(ranged, elements);
+  double rangeTime = timeIt([&] { ranged.eraseRange(0, cutoff); });
+
+  RBTree<int> scattered;
+  fill(scattered, elements);
+  double scatteredTime = timeIt([&] {
+    std::vector<int> matches;
+    scattered.forEach([&](int key) {
+      if (scatter(key)) {
+        matches.push_back(key);
+      }
+    });
+    for (int key : matches) {
+      scattered.deleteNode(key);
+    }
+  });
+  RBTree<int> filtered;
+  fill(filtered, elements);
+  double filterTime = timeIt([&] { filtered.eraseIf(scatter); });
+  doNotOptimize(looped.size() + ranged.size() + scattered.size() +
+                filtered.size());
+  fmt::print("{:>9} {:>6}% {:>10.3f} {:>10.3f} {:>10.3f} {:>10.3f}\n",
+             elements, percent, loopTime * 1e3, rangeTime * 1e3,
+             scatteredTime * 1e3, filterTime * 1e3);
+}
+
+void benchErase(std::size_t maxElements) {
+  fmt::print("{:>9} {:>7} {:>10} {:>10} {:>10} {:>10}   (ms)\n", "elements",
+             "share", "loop", "range", "loop", "eraseIf");
+  for (std::size_t elements = 10000; elements <= maxElements; elements *= 10) {
+    for (int percent : {1, 10, 50, 90}) {
+      eraseRow(elements, percent);
+    }
+  }
+}
+
+RegisterBenchmark erase("erase", &benchErase);
+
+}  // namespace
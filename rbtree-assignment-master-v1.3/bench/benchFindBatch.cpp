@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "RBTree.hpp"
+#include "bench.hpp"
+
+namespace {
+
+// Looping over find() against findBatch() for the same random probes,
+// issued in batches of 10K keys.
+void benchFindBatch(std::size_t maxElements) {
+  const std::size_t BATCH = 10000;
+  auto shuffler = std::default_random_engine(42);
+  fmt::print("{:>10} {:>14} {:>14} {:>9}   (M lookups/s)\n", "size", "find loop",
+             "findBatch", "speedup");
+  for (std::size_t n = 1000; n <= maxElements; n *= 10) {
+    std::vector<int> keys(n);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), shuffler);
+    RBTree<int> rb;
+    for (int key : keys) {
+      rb.addNode(key);
+    }
+    std::size_t probeCount =
+        std::max(BATCH, std::min<std::size_t>(n, 1000000));
+    std::vector<int> probes(probeCount);
+    std::uniform_int_distribution<int> pick(0, 2 * static_cast<int>(n));
+    for (int& probe : probes) {
+      probe = pick(shuffler);
+    }
+
+    std::size_t hits = 0;
+    double loopTime = timeIt([&] {
+      for (int probe : probes) {
+        hits += rb.find(probe) ? 1 : 0;
+      }
+    });
+    std::vector<int> batch;
+    std::vector<bool> found;
+    double batchTime = timeIt([&] {
+      for (std::size_t i = 0; i < probeCount; i += BATCH) {
+        batch.assign(probes.begin() + i,
+                     probes.begin() + std::min(probeCount, i + BATCH));
+        rb.findBatch(batch, found);
+        hits += std::count(found.begin(), found.end(), true);
+      }
+    });
+    doNotOptimize(hits);
+    fmt::print("{:>10} {:>14.2f} {:>14.2f} {:>8.2f}x\n", n,
+               probeCount / loopTime / 1e6, probeCount / batchTime / 1e6,
+               loopTime / batchTime);
+  }
+}
+
+RegisterBenchmark findBatch("findBatch", &benchFindBatch);
+
+}  // namespace
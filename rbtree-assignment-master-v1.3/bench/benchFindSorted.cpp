@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "RBTree.hpp"
+#include "bench.hpp"
+
+namespace {
+
+// Sorted probe sets of different densities, looked up with a find() loop
+// and with findSorted().
+void benchFindSorted(std::size_t maxElements) {
+  auto shuffler = std::default_random_engine(42);
+  fmt::print("{:>10} {:>10} {:>14} {:>14} {:>9}   (M lookups/s)\n", "size",
+             "probes", "find loop", "findSorted", "speedup");
+  for (std::size_t n = 1000; n <= maxElements; n *= 10) {
+    std::vector<int> keys(n);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), shuffler);
+    RBTree<int> rb;
+    for (int key : keys) {
+      rb.addNode(2 * key);
+    }
+    for (std::size_t m = n * 2; m >= 10 && m >= n / 1000; m /= 10) {
+      std::vector<int> probes(m);
+      std::uniform_int_distribution<int> pick(0, 2 * static_cast<int>(n));
+      for (int& probe : probes) {
+        probe = pick(shuffler);
+      }
+      std::sort(probes.begin(), probes.end());
+
+      std::size_t hits = 0;
+      double loopTime = timeIt([&] {
+        for (int probe : probes) {
+          hits += rb.find(probe) ? 1 : 0;
+        }
+      });
+      std::vector<bool> found(m);
+      double sortedTime = timeIt([&] {
+        rb.findSorted(probes.begin(), probes.end(), found.begin());
+      });
+      hits += std::count(found.begin(), found.end(), true);
+      doNotOptimize(hits);
+      fmt::print("{:>10} {:>10} {:>14.2f} {:>14.2f} {:>8.2f}x\n", n, m,
+                 m / loopTime / 1e6, m / sortedTime / 1e6,
+                 loopTime / sortedTime);
+    }
+  }
+}
+
+RegisterBenchmark findSorted("findSorted", &benchFindSorted);
+
+}  // namespace
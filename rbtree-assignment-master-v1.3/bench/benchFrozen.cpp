@@ -0,0 +1,50 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "FrozenRBTree.hpp"
+#include "RBTree.hpp"
+#include "bench.hpp"
+
+namespace {
+
+// Lookup throughput of a tree against its frozen copy, half of the probes
+// missing.
+void benchFrozen(std::size_t maxElements) {
+  auto shuffler = std::default_random_engine(42);
+  fmt::print("{:>10} {:>10} {:>10} {:>8}   (M lookups/s)\n", "size", "tree",
+             "frozen", "speedup");
+  for (std::size_t n = 1000; n <= maxElements; n *= 10) {
+    std::vector<int> keys(n);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), shuffler);
+    RBTree<int> rb;
+    for (int key : keys) {
+      rb.addNode(2 * key);
+    }
+    FrozenRBTree<int> frozen = rb.freeze();
+    std::vector<int> probes(2 * n);
+    std::iota(probes.begin(), probes.end(), 0);
+    std::shuffle(probes.begin(), probes.end(), shuffler);
+
+    std::size_t hits = 0;
+    double treeTime = timeIt([&] {
+      for (int key : probes) {
+        hits += rb.find(key);
+      }
+    });
+    double frozenTime = timeIt([&] {
+      for (int key : probes) {
+        hits += frozen.find(key);
+      }
+    });
+    doNotOptimize(hits);
+    fmt::print("{:>10} {:>10.2f} {:>10.2f} {:>7.1f}x\n", n,
+               probes.size() / treeTime / 1e6,
+               probes.size() / frozenTime / 1e6, treeTime / frozenTime);
+  }
+}
+
+RegisterBenchmark frozen("frozen", &benchFrozen);
+
+}  // namespace
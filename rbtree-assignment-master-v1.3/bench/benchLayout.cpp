@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "IndexedRBTree.hpp"
+#include "RBTree.hpp"
+#include "bench.hpp"
+
+namespace {
+
+template <typename Tree, typename T>
+void layoutRow(const std::string& name, const std::vector<int>& keys,
+               const std::vector<int>& probes) {
+  std::size_t before = heapInUse();
+  auto* rb = new Tree;
+  for (int key : keys) {
+    rb->addNode(static_cast<T>(key));
+  }
+  double bytesPerElement =
+      static_cast<double>(heapInUse() - before) / keys.size();
+  std::size_t hits = 0;
+  double findTime = timeIt([&] {
+    for (int probe : probes) {
+      hits += rb->find(static_cast<T>(probe)) ? 1 : 0;
+    }
+  });
+  doNotOptimize(hits);
+  delete rb;
+  fmt::print("{:>10} {:<18} {:>11} {:>16.1f} {:>14.2f}\n", keys.size(), name,
+             Tree::NODE_BYTES, bytesPerElement,
+             probes.size() / findTime / 1e6);
+}
+
+// Node size, heap bytes per element (node plus malloc overhead) and random
+// lookup throughput for both node layouts and the index-linked tree.
+void benchLayout(std::size_t maxElements) {
+  auto shuffler = std::default_random_engine(42);
+  fmt::print("{:>10} {:<18} {:>11} {:>16} {:>14}\n", "size", "tree",
+             "node bytes", "heap bytes/elem", "M finds/s");
+  for (std::size_t n = 1000; n <= maxElements; n *= 10) {
+    std::vector<int> keys(n);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), shuffler);
+    std::vector<int> probes(std::min<std::size_t>(n, 1000000));
+    std::uniform_int_distribution<int> pick(0, static_cast<int>(n) - 1);
+    for (int& probe : probes) {
+      probe = pick(shuffler);
+    }
+    layoutRow<RBTree<int, NodeLayout::STANDARD>, int>("int standard", keys,
+                                                      probes);
+    layoutRow<RBTree<int, NodeLayout::COMPACT>, int>("int compact", keys,
+                                                     probes);
+    layoutRow<IndexedRBTree<int>, int>("int indexed", keys, probes);
+    layoutRow<RBTree<long, NodeLayout::STANDARD>, long>("long standard", keys,
+                                                        probes);
+    layoutRow<RBTree<long, NodeLayout::COMPACT>, long>("long compact", keys,
+                                                       probes);
+    layoutRow<IndexedRBTree<long>, long>("long indexed", keys, probes);
+    layoutRow<RBTree<double, NodeLayout::STANDARD>, double>("double standard",
+                                                            keys, probes);
+    layoutRow<RBTree<double, NodeLayout::COMPACT>, double>("double compact",
+                                                           keys, probes);
+    layoutRow<IndexedRBTree<double>, double>("double indexed", keys, probes);
+  }
+}
+
+RegisterBenchmark layout("layout", &benchLayout);
+
+}  // namespace
@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "RBTree.hpp"
+#include "bench.hpp"
+
+namespace {
+
+using Partials = std::vector<std::unique_ptr<RBTree<int>>>;
+
+// Spreads keys over parts trees, either in contiguous ranges or round robin
+// so that every tree spans the whole key range.
+Partials makePartials(const std::vector<int>& keys, std::size_t parts,
+                      bool ranges) {
+  Partials trees;
+  for (std::size_t p = 0; p < parts; ++p) {
+    trees.push_back(std::make_unique<RBTree<int>>());
+  }
+  for (int key : keys) {
+    std::size_t p = ranges ? static_cast<std::size_t>(key) * parts / keys.size()
+                           : static_cast<std::size_t>(key) % parts;
+    trees[p]->addNode(key);
+  }
+  return trees;
+}
+
+void mergeRow(std::size_t elements, std::size_t parts, bool ranges) {
+  auto shuffler = std::default_random_engine(42);
+  std::vector<int> keys(elements);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), shuffler);
+
+  Partials copied = makePartials(keys, parts, ranges);
+  RBTree<int> copyInto;
+  double copyTime = timeIt([&] {
+    for (auto& tree : copied) {
+      tree->forEach([&](const int& key) { copyInto.addNode(key); });
+      tree->clear();
+    }
+  });
+  Partials relinked = makePartials(keys, parts, ranges);
+  RBTree<int> mergeInto;
+  double mergeTime = timeIt([&] {
+    for (auto& tree : relinked) {
+      mergeInto.merge(*tree);
+    }
+  });
+  doNotOptimize(copyInto.size() + mergeInto.size());
+  fmt::print("{:>9} {:>6} {:>7} {:>10.3f} {:>10.3f}\n", elements, parts,
+             ranges ? "ranges" : "mixed", copyTime * 1e3, mergeTime * 1e3);
+}
+
+// Combining per-thread partial results into one tree, by copying every
+// element versus merge().
+void benchMerge(std::size_t maxElements) {
+  fmt::print("{:>9} {:>6} {:>7} {:>10} {:>10}   (ms)\n", "elements", "parts",
+             "keys", "copy", "merge");
+  for (std::size_t elements = 1 << 14; elements <= maxElements; elements *= 8) {
+    for (bool ranges : {true, false}) {
+      mergeRow(elements, 8, ranges);
+    }
+  }
+}
+
+RegisterBenchmark merge("merge", &benchMerge);
+
+}  // namespace
@@ -0,0 +1,54 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "ParentlessRBTree.hpp"
+#include "RBTree.hpp"
+#include "bench.hpp"
+
+namespace {
+
+template <typename Tree>
+void mutationRow(const std::string& name, const std::vector<int>& keys,
+                 const std::vector<int>& deleteOrder) {
+  std::size_t before = heapInUse();
+  auto* rb = new Tree;
+  double insertTime = timeIt([&] {
+    for (int key : keys) {
+      rb->addNode(key);
+    }
+  });
+  double bytesPerElement =
+      static_cast<double>(heapInUse() - before) / keys.size();
+  double deleteTime = timeIt([&] {
+    for (int key : deleteOrder) {
+      rb->deleteNode(key);
+    }
+  });
+  delete rb;
+  fmt::print("{:>10} {:<12} {:>11} {:>16.1f} {:>10.2f} {:>10.2f}\n",
+             keys.size(), name, Tree::NODE_BYTES, bytesPerElement,
+             keys.size() / insertTime / 1e6,
+             deleteOrder.size() / deleteTime / 1e6);
+}
+
+// Memory and insert/delete throughput with and without parent links.
+void benchParentless(std::size_t maxElements) {
+  auto shuffler = std::default_random_engine(42);
+  fmt::print("{:>10} {:<12} {:>11} {:>16} {:>10} {:>10}   (M ops/s)\n",
+             "size", "tree", "node bytes", "heap bytes/elem", "insert",
+             "delete");
+  for (std::size_t n = 1000; n <= maxElements; n *= 10) {
+    std::vector<int> keys(n);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), shuffler);
+    std::vector<int> deleteOrder = keys;
+    std::shuffle(deleteOrder.begin(), deleteOrder.end(), shuffler);
+    mutationRow<RBTree<int>>("parent", keys, deleteOrder);
+    mutationRow<ParentlessRBTree<int>>("parentless", keys, deleteOrder);
+  }
+}
+
+RegisterBenchmark parentless("parentless", &benchParentless);
+
+}  // namespace
@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "RBTree.hpp"
+#include "bench.hpp"
+
+namespace {
+
+void fill(RBTree<int>& rb, std::size_t elements) {
+  auto shuffler = std::default_random_engine(42);
+  std::vector<int> keys(elements);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), shuffler);
+  for (int key : keys) {
+    rb.addNode(key);
+  }
+}
+
+void partitionRow(std::size_t elements, int shards) {
+  auto inShard = [shards](int key) { return key * 37 % shards == 0; };
+
+  RBTree<int> copied;
+  fill(copied, elements);
+  RBTree<int> copyMatching;
+  RBTree<int> copyRest;
+  double copyTime = timeIt([&] {
+    for (int key : std::move(copied).inOrder()) {
+      (inShard(key) ? copyMatching : copyRest).addNode(key);
+    }
+  });
+  RBTree<int> relinked;
+  fill(relinked, elements);
+  RBTree<int> matching;
+  RBTree<int> rest;
+  double partitionTime =
+      timeIt([&] { relinked.partition(inShard, matching, rest); });
+  doNotOptimize(copyMatching.size() + copyRest.size() + matching.size() +
+                rest.size());
+  fmt::print("{:>9} {:>7} {:>10.3f} {:>10.3f}\n", elements, shards,
+             copyTime * 1e3, partitionTime * 1e3);
+}
+
+// Moving one shard out of a tree, by inOrder() and an addNode() per element
+// versus partition().
+void benchPartition(std::size_t maxElements) {
+  fmt::print("{:>9} {:>7} {:>10} {:>10}   (ms)\n", "elements", "shards",
+             "copy", "partition");
+  for (std::size_t elements = 10000; elements <= maxElements; elements *= 10) {
+    for (int shards : {2, 16}) {
+      partitionRow(elements, shards);
+    }
+  }
+}
+
+RegisterBenchmark partition("partition", &benchPartition);
+
+}  // namespace
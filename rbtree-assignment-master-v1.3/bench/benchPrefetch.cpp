@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "RBTree.hpp"
+#include "bench.hpp"
+
+namespace {
+
+std::string modeName(Prefetch mode) {
+  switch (mode) {
+    case Prefetch::NONE:
+      return "none";
+    case Prefetch::CHILDREN:
+      return "children";
+    case Prefetch::GRANDCHILDREN:
+      return "grandchildren";
+  }
+  return "";
+}
+
+// Insert, find and delete throughput for every prefetch mode, with tree
+// sizes growing by 10x from 1K. Pass 100000000 as the limit for the full
+// 1K - 100M matrix (needs about 6 GB of memory).
+void benchPrefetch(std::size_t maxElements) {
+  auto shuffler = std::default_random_engine(42);
+  fmt::print("{:>10} {:<14} {:>12} {:>12} {:>12}   (M ops/s)\n", "size", "mode",
+             "insert", "find", "delete");
+  for (std::size_t n = 1000; n <= maxElements; n *= 10) {
+    std::vector<int> keys(n);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), shuffler);
+    std::size_t probeCount = std::min<std::size_t>(n, 1000000);
+    std::vector<int> probes(probeCount);
+    std::uniform_int_distribution<int> pick(0, static_cast<int>(n) - 1);
+    for (int& probe : probes) {
+      probe = pick(shuffler);
+    }
+    std::size_t deleteCount = std::min<std::size_t>(n / 2, 100000);
+
+    for (Prefetch mode :
+         {Prefetch::NONE, Prefetch::CHILDREN, Prefetch::GRANDCHILDREN}) {
+      RBTree<int> rb;
+      rb.setPrefetch(mode);
+      double insertTime = timeIt([&] {
+        for (int key : keys) {
+          rb.addNode(key);
+        }
+      });
+      std::size_t hits = 0;
+      double findTime = timeIt([&] {
+        for (int probe : probes) {
+          hits += rb.find(probe) ? 1 : 0;
+        }
+      });
+      doNotOptimize(hits);
+      double deleteTime = timeIt([&] {
+        for (std::size_t i = 0; i < deleteCount; ++i) {
+          rb.deleteNode(keys[i]);
+        }
+      });
+      fmt::print("{:>10} {:<14} {:>12.2f} {:>12.2f} {:>12.2f}\n", n,
+                 modeName(mode), n / insertTime / 1e6,
+                 probeCount / findTime / 1e6, deleteCount / deleteTime / 1e6);
+    }
+  }
+}
+
+RegisterBenchmark prefetch("prefetch", &benchPrefetch);
+
+}  // namespace
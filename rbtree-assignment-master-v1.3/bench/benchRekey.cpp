@@ -0,0 +1,72 @@
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "RBTree.hpp"
+#include "bench.hpp"
+
+namespace {
+
+// A scheduler queue entry: ordered by priority, ties broken by id.
+using Entry = std::pair<long, int>;
+
+// Builds a queue of items with spread out priorities, then changes the
+// priority of random items, each by at most maxStep. Returns millions of
+// updates per second.
+template <typename Update>
+double updateRate(std::size_t items, long maxStep, Update update) {
+  std::default_random_engine gen(42);
+  std::uniform_int_distribution<long> spread(0, static_cast<long>(items) * 64);
+  std::uniform_int_distribution<long> step(-maxStep, maxStep);
+  std::uniform_int_distribution<std::size_t> pick(0, items - 1);
+  RBTree<Entry> queue;
+  std::vector<long> priority(items);
+  for (std::size_t i = 0; i < items; ++i) {
+    priority[i] = spread(gen);
+    queue.addNode({priority[i], static_cast<int>(i)});
+  }
+  const std::size_t UPDATES = 1000000;
+  double seconds = timeIt([&] {
+    for (std::size_t u = 0; u < UPDATES; ++u) {
+      std::size_t i = pick(gen);
+      long next = priority[i] + step(gen);
+      update(queue, Entry(priority[i], static_cast<int>(i)),
+             Entry(next, static_cast<int>(i)));
+      priority[i] = next;
+    }
+  });
+  doNotOptimize(queue.size());
+  return UPDATES / seconds / 1e6;
+}
+
+void rekeyRow(std::size_t items, long maxStep) {
+  double reinsert = updateRate(
+      items, maxStep, [](RBTree<Entry>& queue, const Entry& from,
+                         const Entry& to) {
+        queue.deleteNode(from);
+        queue.addNode(to);
+      });
+  double rekey = updateRate(
+      items, maxStep,
+      [](RBTree<Entry>& queue, const Entry& from, const Entry& to) {
+        queue.rekey(from, to);
+      });
+  fmt::print("{:>9} {:>9} {:>10.2f} {:>10.2f}\n", items, maxStep,
+             reinsert, rekey);
+}
+
+// Priority updates in a scheduler queue, with deleteNode() + addNode()
+// versus rekey(). Small steps mostly keep an item between its neighbours.
+void benchRekey(std::size_t maxElements) {
+  fmt::print("{:>9} {:>9} {:>10} {:>10}   (M updates/s)\n", "items",
+             "max step", "reinsert", "rekey");
+  for (std::size_t items = 1000; items <= maxElements; items *= 10) {
+    for (long maxStep : {8L, 1L << 30}) {
+      rekeyRow(items, maxStep);
+    }
+  }
+}
+
+RegisterBenchmark rekey("rekey", &benchRekey);
+
+}  // namespace
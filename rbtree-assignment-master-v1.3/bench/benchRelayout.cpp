@@ -0,0 +1,55 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "RBTree.hpp"
+#include "bench.hpp"
+
+namespace {
+
+double lookupRate(RBTree<int>& rb, const std::vector<int>& probes) {
+  std::size_t hits = 0;
+  double seconds = timeIt([&] {
+    for (int key : probes) {
+      hits += rb.find(key);
+    }
+  });
+  doNotOptimize(hits);
+  return probes.size() / seconds / 1e6;
+}
+
+// Lookup throughput of a tree whose nodes were scattered by churn, before
+// and after relayout(). Without access to hardware counters the lookup
+// rate stands in for the cache miss rate.
+void benchRelayout(std::size_t maxElements) {
+  auto shuffler = std::default_random_engine(42);
+  fmt::print("{:>10} {:>10} {:>10} {:>12}   (M lookups/s)\n", "size",
+             "churned", "relayout", "relayout ms");
+  for (std::size_t n = 1000; n <= maxElements; n *= 10) {
+    std::vector<int> keys(2 * n);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), shuffler);
+    RBTree<int> rb;
+    for (std::size_t i = 0; i < n; ++i) {
+      rb.addNode(keys[i]);
+    }
+    // Replace every element once, so that the nodes end up in allocation
+    // order unrelated to the tree shape.
+    for (std::size_t i = 0; i < n; ++i) {
+      rb.deleteNode(keys[i]);
+      rb.addNode(keys[n + i]);
+    }
+    std::vector<int> probes(keys.begin() + n, keys.end());
+    std::shuffle(probes.begin(), probes.end(), shuffler);
+
+    double churned = lookupRate(rb, probes);
+    double relayoutTime = timeIt([&] { rb.relayout(); });
+    double relaidOut = lookupRate(rb, probes);
+    fmt::print("{:>10} {:>10.2f} {:>10.2f} {:>12.2f}\n", n, churned,
+               relaidOut, relayoutTime * 1e3);
+  }
+}
+
+RegisterBenchmark relayout("relayout", &benchRelayout);
+
+}  // namespace
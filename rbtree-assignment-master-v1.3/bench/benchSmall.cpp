@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "RBTree.hpp"
+#include "bench.hpp"
+
+namespace {
+
+void smallRow(std::size_t elements, std::size_t limit) {
+  const std::size_t TREES = 2000;
+  auto shuffler = std::default_random_engine(42);
+  std::vector<int> keys(elements);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), shuffler);
+
+  std::size_t before = heapInUse();
+  std::vector<RBTree<int>*> trees;
+  double insertTime = timeIt([&] {
+    for (std::size_t t = 0; t < TREES; ++t) {
+      auto* rb = new RBTree<int>;
+      rb->setSmallLimit(limit);
+      for (int key : keys) {
+        rb->addNode(key);
+      }
+      trees.push_back(rb);
+    }
+  });
+  double bytesPerTree = static_cast<double>(heapInUse() - before) / TREES;
+  std::size_t hits = 0;
+  double findTime = timeIt([&] {
+    for (RBTree<int>* rb : trees) {
+      for (int key : keys) {
+        hits += rb->find(key);
+      }
+    }
+  });
+  doNotOptimize(hits);
+  for (RBTree<int>* rb : trees) {
+    delete rb;
+  }
+  double ops = static_cast<double>(TREES * elements);
+  fmt::print("{:>9} {:>6} {:>15.0f} {:>10.2f} {:>10.2f}\n", elements, limit,
+             bytesPerTree, ops / insertTime / 1e6, ops / findTime / 1e6);
+}
+
+// Many small trees with and without the sorted array representation.
+void benchSmall(std::size_t) {
+  fmt::print("{:>9} {:>6} {:>15} {:>10} {:>10}   (M ops/s)\n", "elements",
+             "limit", "heap bytes/tree", "insert", "find");
+  for (std::size_t elements : {8, 32, 64}) {
+    smallRow(elements, 0);
+    smallRow(elements, 64);
+  }
+}
+
+RegisterBenchmark small("small", &benchSmall);
+
+}  // namespace
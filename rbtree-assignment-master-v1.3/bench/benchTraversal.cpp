@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "RBTree.hpp"
+#include "bench.hpp"
+
+namespace {
+
+template <typename T>
+void fillTree(RBTree<T>& rb, const std::vector<T>& values) {
+  for (const T& value : values) {
+    rb.addNode(value);
+  }
+}
+
+template <typename T>
+void traversalRow(const std::string& type, const std::vector<T>& values) {
+  RBTree<T> rb;
+  fillTree(rb, values);
+  double n = static_cast<double>(values.size());
+  auto report = [&](const std::string& method, double seconds) {
+    fmt::print("{:>8} {:>10} {:<34} {:>10.1f} M elements/s\n", type,
+               values.size(), method, n / seconds / 1e6);
+  };
+
+  report("unreserved push_back copy (before)", timeIt([&] {
+           std::vector<T> order;
+           rb.forEach([&](const T& e) { order.push_back(e); });
+           doNotOptimize(order);
+         }));
+  report("inOrder()", timeIt([&] {
+           std::vector<T> order = rb.inOrder();
+           doNotOptimize(order);
+         }));
+  std::vector<T> buffer(values.size());
+  report("inOrderInto(preallocated)", timeIt([&] {
+           doNotOptimize(rb.inOrderInto(buffer.begin()));
+         }));
+  report("forEach()", timeIt([&] {
+           std::size_t visited = 0;
+           rb.forEach([&](const T&) { ++visited; });
+           doNotOptimize(visited);
+         }));
+  report("std::move(tree).inOrder()", timeIt([&] {
+           std::vector<T> order = std::move(rb).inOrder();
+           doNotOptimize(order);
+         }));
+}
+
+void benchTraversal(std::size_t maxElements) {
+  auto shuffler = std::default_random_engine(42);
+  for (std::size_t n = 1024; n <= maxElements; n *= 32) {
+    std::vector<int> ints(n);
+    std::iota(ints.begin(), ints.end(), 0);
+    std::shuffle(ints.begin(), ints.end(), shuffler);
+    traversalRow<int>("int", ints);
+
+    std::vector<std::string> strings;
+    strings.reserve(n);
+    for (int i : ints) {
+      strings.push_back(fmt::format("element-{:016}", i));
+    }
+    traversalRow<std::string>("string", strings);
+  }
+}
+
+RegisterBenchmark traversal("traversal", &benchTraversal);
+
+}  // namespace
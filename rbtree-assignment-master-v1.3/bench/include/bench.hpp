@@ -0,0 +1,58 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+/** A benchmark receives the largest element count it is allowed to use */
+using BenchmarkFn = void (*)(std::size_t maxElements);
+
+struct Benchmark {
+  std::string name;
+  BenchmarkFn run;
+};
+
+inline std::vector<Benchmark>& benchmarks() {
+  static std::vector<Benchmark> registered;
+  return registered;
+}
+
+/** A static instance in a benchmark source file makes it runnable by name */
+struct RegisterBenchmark {
+  RegisterBenchmark(const std::string& name, BenchmarkFn run) {
+    benchmarks().push_back({name, run});
+  }
+};
+
+/** Runs fn once and returns the elapsed wall-clock time in seconds */
+template <typename F>
+double timeIt(F&& fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+/** Bytes currently handed out by malloc, or 0 where that is unknown */
+inline std::size_t heapInUse() {
+#ifdef __GLIBC__
+  struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+#else
+  return 0;
+#endif
+}
+
+/** Keeps the optimiser from dropping a computed value */
+template <typename V>
+void doNotOptimize(const V& value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif
@@ -154,6 +154,14 @@ class RBReader {
     return false;
   }
 
+  // All trees of a type share the nil node, so no tree may write to it.
+  bool nilIsUntouched() {
+    const NodeU* nil = tree->nilNode;
+    return nil->parent == nullptr && nil->leftChild == nullptr &&
+           nil->rightChild == nullptr && nil->colour == Colour::BLACK &&
+           nil->subtreeHeight == 0;
+  }
+
   bool redNodesHaveBlackChildren() {
     return redNodesHaveBlackChildren(tree->root);
   }
@@ -192,6 +200,27 @@ class RBReader {
     ancestorQuery(blackAncestors, cnt, curr->rightChild);
   }
 
+  int blackHeight() {
+    int cnt = 0;
+    for (NodeU* curr = tree->root; curr != tree->nilNode;
+         curr = curr->leftChild) {
+      if (curr->colour == Colour::BLACK) {
+        ++cnt;
+      }
+    }
+    return cnt;
+  }
+
+  // Counted from scratch, in edges like RBTree::height().
+  int height() { return height(tree->root); }
+
+  int height(NodeU* curr) {
+    if (curr == tree->nilNode) {
+      return -1;
+    }
+    return 1 + std::max(height(curr->leftChild), height(curr->rightChild));
+  }
+
   bool pathToAncestorsCorrect() {
     std::vector<U> elements = tree->inOrder();
     for (auto e : elements) {
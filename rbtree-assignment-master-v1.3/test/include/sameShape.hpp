@@ -0,0 +1,24 @@
+#ifndef SAMESHAPE_HPP
+#define SAMESHAPE_HPP
+
+#include "RBTree.hpp"
+
+/**
+ * True if tree holds the same elements as reference in the same shape:
+ * equal sizes, height bounds and heights, and the same path from the root
+ * to every element. Trees running the same insert/delete algorithms end up
+ * like this after the same operations.
+ */
+template <typename Tree, typename T>
+bool sameShape(Tree& tree, RBTree<T>& reference) {
+  bool same = tree.size() == reference.size() &&
+              tree.heightBounds() == reference.heightBounds() &&
+              tree.height() == reference.height();
+  reference.forEach([&](const T& e) {
+    same = same && tree.pathFromRoot(e) == reference.pathFromRoot(e);
+    return same;
+  });
+  return same;
+}
+
+#endif
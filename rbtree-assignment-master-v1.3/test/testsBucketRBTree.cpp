@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <set>
+
+#include "BucketRBTree.hpp"
+#include "catch.hpp"
+
+/**
+ * True if the bucket tree holds exactly the elements of reference and its
+ * tree of buckets is within the red-black height bounds.
+ */
+template <typename Tree>
+bool sameContents(Tree& tree, const std::set<int>& reference) {
+  std::vector<int> expected(reference.begin(), reference.end());
+  auto bounds = tree.heightBounds();
+  int h = tree.height();
+  return tree.size() == reference.size() && tree.inOrder() == expected &&
+         (reference.empty() ? h == -1
+                            : bounds.first <= h && h <= bounds.second);
+}
+
+SCENARIO("A tree of buckets holds the same set as a tree of elements") {
+  GIVEN("An empty tree") {
+    BucketRBTree<int> rb;
+    THEN("min() and max() should throw") {
+      CHECK_THROWS(rb.min());
+      CHECK_THROWS(rb.max());
+    }
+    THEN("height should be -1") { REQUIRE(rb.height() == -1); }
+    THEN("deleteNode(42) should return false") { REQUIRE(!rb.deleteNode(42)); }
+    THEN("find(42) should return false") { REQUIRE(!rb.find(42)); }
+  }
+
+  GIVEN("A tree and a std::set receiving the same shuffled inserts") {
+    auto shuffler = std::default_random_engine(42);
+    const int ITERATIONS = 2000;
+    BucketRBTree<int, 8> buckets;
+    std::set<int> reference;
+    std::vector<int> v(ITERATIONS);
+    std::iota(std::begin(v), std::end(v), -ITERATIONS / 2);
+    std::shuffle(v.begin(), v.end(), shuffler);
+    for (int i : v) {
+      REQUIRE(buckets.addNode(i) == reference.insert(i).second);
+    }
+    REQUIRE(!buckets.addNode(v[0]));
+    REQUIRE(sameContents(buckets, reference));
+
+    THEN("Buckets should be shared between elements") {
+      REQUIRE(buckets.bucketCount() * 8 >= reference.size());
+      REQUIRE(buckets.bucketCount() < reference.size() / 2);
+      REQUIRE(buckets.min() == -ITERATIONS / 2);
+      REQUIRE(buckets.max() == ITERATIONS / 2 - 1);
+      REQUIRE(buckets.find(0));
+      REQUIRE(!buckets.find(ITERATIONS));
+    }
+
+    WHEN("Deleting every value in another order") {
+      std::shuffle(v.begin(), v.end(), shuffler);
+      for (int k = 0; k < ITERATIONS; ++k) {
+        INFO("Deleting: " << v[k]);
+        REQUIRE(buckets.deleteNode(v[k]));
+        REQUIRE(!buckets.find(v[k]));
+        reference.erase(v[k]);
+        if (k % 97 == 0) {
+          REQUIRE(sameContents(buckets, reference));
+        }
+      }
+      THEN("The tree should be empty") {
+        REQUIRE(buckets.size() == 0);
+        REQUIRE(buckets.bucketCount() == 0);
+        REQUIRE(buckets.height() == -1);
+      }
+    }
+
+    WHEN("Mixing inserts and deletes over a wider range") {
+      std::uniform_int_distribution<int> dist(-ITERATIONS, ITERATIONS);
+      for (int k = 0; k < 4 * ITERATIONS; ++k) {
+        int key = dist(shuffler);
+        if (k % 3 == 0) {
+          REQUIRE(buckets.addNode(key) == reference.insert(key).second);
+        } else {
+          REQUIRE(buckets.deleteNode(key) == (reference.erase(key) == 1));
+        }
+      }
+      THEN("The contents should still match") {
+        REQUIRE(sameContents(buckets, reference));
+      }
+      THEN("forEach should stop when asked") {
+        int visited = 0;
+        REQUIRE(!buckets.forEach([&](int) { return ++visited < 10; }));
+        REQUIRE(visited == 10);
+      }
+    }
+  }
+
+  GIVEN("Sequential inserts") {
+    BucketRBTree<int> buckets;
+    for (int i = 0; i < 1000; ++i) {
+      buckets.addNode(i);
+    }
+    THEN("Every bucket split should leave them at least half full") {
+      REQUIRE(buckets.bucketCount() <= 1000 / 8 + 1);
+      REQUIRE(buckets.inOrder().size() == 1000);
+    }
+  }
+}
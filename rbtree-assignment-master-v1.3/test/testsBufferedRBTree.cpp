@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "BufferedRBTree.hpp"
+#include "catch.hpp"
+
+SCENARIO("Buffering writes in front of a frozen base") {
+  GIVEN("An empty tree") {
+    BufferedRBTree<int> rb;
+    THEN("It should hold nothing") {
+      REQUIRE(rb.size() == 0);
+      REQUIRE(!rb.find(0));
+      REQUIRE(!rb.deleteNode(0));
+      REQUIRE(rb.inOrder().empty());
+    }
+  }
+
+  GIVEN("A tree and a std::set receiving the same random writes") {
+    auto shuffler = std::default_random_engine(42);
+    std::uniform_int_distribution<int> dist(0, 500);
+    BufferedRBTree<int> rb(16);
+    std::set<int> reference;
+    for (int k = 0; k < 5000; ++k) {
+      int key = dist(shuffler);
+      if (k % 3 != 2) {
+        REQUIRE(rb.addNode(key) == reference.insert(key).second);
+      } else {
+        REQUIRE(rb.deleteNode(key) == (reference.erase(key) == 1));
+      }
+      REQUIRE(rb.size() == reference.size());
+      REQUIRE(rb.bufferSize() <= std::max<std::size_t>(16, rb.size()));
+    }
+
+    THEN("Lookups and contents should match") {
+      for (int i = -1; i <= 501; ++i) {
+        REQUIRE(rb.find(i) == (reference.count(i) == 1));
+      }
+      REQUIRE(rb.inOrder() ==
+              std::vector<int>(reference.begin(), reference.end()));
+    }
+    WHEN("Compacting explicitly") {
+      rb.compact();
+      THEN("The buffer should be empty and the contents unchanged") {
+        REQUIRE(rb.bufferSize() == 0);
+        REQUIRE(rb.size() == reference.size());
+        REQUIRE(rb.inOrder() ==
+                std::vector<int>(reference.begin(), reference.end()));
+      }
+      AND_WHEN("Deleting and re-adding an element of the base") {
+        int key = *reference.begin();
+        REQUIRE(rb.deleteNode(key));
+        REQUIRE(!rb.find(key));
+        REQUIRE(!rb.deleteNode(key));
+        REQUIRE(rb.addNode(key));
+        THEN("It should be back without a buffered insert") {
+          REQUIRE(rb.find(key));
+          REQUIRE(!rb.addNode(key));
+          REQUIRE(rb.bufferSize() == 0);
+        }
+      }
+    }
+  }
+}
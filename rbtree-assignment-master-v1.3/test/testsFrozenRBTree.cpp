@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <string>
+
+#include "FrozenRBTree.hpp"
+#include "RBTree.hpp"
+#include "catch.hpp"
+
+SCENARIO("Freezing a tree into a read-only copy") {
+  GIVEN("An empty tree") {
+    RBTree<int> rb;
+    FrozenRBTree<int> frozen = rb.freeze();
+    THEN("The copy should be empty") {
+      REQUIRE(frozen.size() == 0);
+      REQUIRE(!frozen.find(0));
+      REQUIRE(frozen.inOrder().empty());
+      CHECK_THROWS(frozen.min());
+      CHECK_THROWS(frozen.max());
+    }
+  }
+
+  GIVEN("Trees of every size up to 70") {
+    auto shuffler = std::default_random_engine(42);
+    for (int n = 1; n <= 70; ++n) {
+      INFO("Size: " << n);
+      RBTree<int> rb;
+      std::vector<int> v(n);
+      std::iota(v.begin(), v.end(), 0);
+      std::shuffle(v.begin(), v.end(), shuffler);
+      for (int i : v) {
+        rb.addNode(2 * i);
+      }
+      FrozenRBTree<int> frozen = rb.freeze();
+      REQUIRE(frozen.size() == rb.size());
+      REQUIRE(frozen.inOrder() == rb.inOrder());
+      REQUIRE(frozen.min() == rb.min());
+      REQUIRE(frozen.max() == rb.max());
+      for (int i = -2; i <= 2 * n + 1; ++i) {
+        REQUIRE(frozen.find(i) == rb.find(i));
+      }
+      // The minimum sits in the leftmost slot of the bottom level.
+      std::size_t leftmost = 1;
+      while (2 * leftmost <= frozen.size()) {
+        leftmost *= 2;
+      }
+      const int* slots = &frozen.min() - leftmost;
+      REQUIRE(reinterpret_cast<std::uintptr_t>(slots) % 64 == 0);
+    }
+  }
+
+  GIVEN("A frozen copy of a tree of strings") {
+    RBTree<std::string> rb;
+    for (const char* word : {"pear", "apple", "fig", "kiwi", "lime"}) {
+      rb.addNode(word);
+    }
+    FrozenRBTree<std::string> frozen = rb.freeze();
+    WHEN("The tree is changed afterwards") {
+      rb.deleteNode("fig");
+      rb.addNode("plum");
+      THEN("The copy should keep the old contents") {
+        REQUIRE(frozen.find("fig"));
+        REQUIRE(!frozen.find("plum"));
+        REQUIRE(frozen.inOrder() == std::vector<std::string>{
+                                        "apple", "fig", "kiwi", "lime",
+                                        "pear"});
+      }
+    }
+    THEN("forEach should stop when asked") {
+      int visited = 0;
+      REQUIRE(!frozen.forEach(
+          [&](const std::string&) { return ++visited < 2; }));
+      REQUIRE(visited == 2);
+    }
+  }
+}
@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+#include "IndexedRBTree.hpp"
+#include "RBTree.hpp"
+#include "catch.hpp"
+#include "sameShape.hpp"
+
+SCENARIO("An index-linked tree behaves like the pointer-linked one") {
+  GIVEN("An empty tree") {
+    IndexedRBTree<int> rb;
+    THEN("min() and max() should throw") {
+      CHECK_THROWS(rb.min());
+      CHECK_THROWS(rb.max());
+    }
+    THEN("height should be -1") { REQUIRE(rb.height() == -1); }
+    THEN("find(42) should return false") { REQUIRE(!rb.find(42)); }
+  }
+
+  GIVEN("An indexed and a pointer-based tree receiving the same operations") {
+    auto shuffler = std::default_random_engine(42);
+    const int ITERATIONS = 300;
+    IndexedRBTree<int> indexed;
+    RBTree<int> pointers;
+    std::vector<int> v(ITERATIONS);
+    std::iota(std::begin(v), std::end(v), -ITERATIONS / 2);
+    std::shuffle(v.begin(), v.end(), shuffler);
+    for (int i : v) {
+      REQUIRE(indexed.addNode(i) == pointers.addNode(i));
+    }
+    REQUIRE(!indexed.addNode(v[0]));
+
+    THEN("Both trees should have the same shape") {
+      REQUIRE(sameShape(indexed, pointers));
+      REQUIRE(indexed.inOrder() == pointers.inOrder());
+      REQUIRE(indexed.min() == -ITERATIONS / 2);
+      REQUIRE(indexed.max() == ITERATIONS / 2 - 1);
+    }
+
+    WHEN("Deleting and re-inserting values") {
+      std::shuffle(v.begin(), v.end(), shuffler);
+      for (int i = 0; i < ITERATIONS / 2; ++i) {
+        REQUIRE(indexed.deleteNode(v[i]) == pointers.deleteNode(v[i]));
+      }
+      REQUIRE(!indexed.deleteNode(v[0]));
+      REQUIRE(sameShape(indexed, pointers));
+      for (int i = 0; i < ITERATIONS / 4; ++i) {
+        REQUIRE(indexed.addNode(v[i]) == pointers.addNode(v[i]));
+      }
+      THEN("Freed slots should be reused and the shapes should still match") {
+        REQUIRE(sameShape(indexed, pointers));
+      }
+      AND_WHEN("Deleting everything") {
+        pointers.forEach([&](const int& e) { indexed.deleteNode(e); });
+        THEN("The tree should be empty") {
+          REQUIRE(indexed.size() == 0);
+          REQUIRE(indexed.height() == -1);
+          REQUIRE(indexed.heightBounds() == std::pair<int, int>{-1, -1});
+        }
+      }
+    }
+
+    WHEN("Taking a snapshot and restoring it into another tree") {
+      std::vector<unsigned char> image;
+      indexed.snapshot(image);
+      IndexedRBTree<int> restored;
+      restored.addNode(12345);
+      restored.restore(image.data(), image.size());
+      THEN("The restored tree should have the same shape") {
+        REQUIRE(sameShape(restored, pointers));
+      }
+      THEN("The restored tree should keep working") {
+        REQUIRE(restored.deleteNode(v[0]));
+        REQUIRE(pointers.deleteNode(v[0]));
+        REQUIRE(restored.addNode(1000));
+        REQUIRE(pointers.addNode(1000));
+        REQUIRE(sameShape(restored, pointers));
+        REQUIRE(indexed.find(v[0]));
+      }
+      THEN("A truncated image should be rejected") {
+        REQUIRE_THROWS_AS(restored.restore(image.data(), image.size() - 1),
+                          std::invalid_argument);
+        REQUIRE_THROWS_AS(restored.restore(image.data(), 3),
+                          std::invalid_argument);
+        REQUIRE(sameShape(restored, pointers));
+      }
+      THEN("An image linking past its slots should be rejected") {
+        const std::size_t NODE_BYTES = IndexedRBTree<int>::NODE_BYTES;
+        // An empty tree's image is the header and the nil slot.
+        std::vector<unsigned char> empty;
+        IndexedRBTree<int>().snapshot(empty);
+        std::size_t slots = (image.size() - empty.size()) / NODE_BYTES + 1;
+        // The last node starts with its parent link.
+        auto past = static_cast<IndexedRBTree<int>::Index>(slots);
+        std::memcpy(image.data() + image.size() - NODE_BYTES, &past,
+                    sizeof(past));
+        REQUIRE_THROWS_AS(restored.restore(image.data(), image.size()),
+                          std::invalid_argument);
+        REQUIRE(sameShape(restored, pointers));
+      }
+    }
+
+    WHEN("Copying the tree") {
+      IndexedRBTree<int> copy = indexed;
+      copy.clear();
+      THEN("The original should be unaffected") {
+        REQUIRE(copy.size() == 0);
+        REQUIRE(sameShape(indexed, pointers));
+      }
+    }
+  }
+}
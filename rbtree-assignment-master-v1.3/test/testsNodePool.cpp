@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <vector>
+
+#include "NodePool.hpp"
+#include "catch.hpp"
+
+namespace {
+struct Block {
+  long words[4];
+};
+}  // namespace
+
+SCENARIO("Allocating nodes from slabs") {
+  GIVEN("An empty pool") {
+    NodePool<Block> pool;
+    const std::size_t SLOTS = NodePool<Block>::SLOTS_PER_SLAB;
+    THEN("It should hold no slabs") { REQUIRE(pool.slabCount() == 0); }
+
+    WHEN("Allocating three slabs worth of slots") {
+      std::vector<void*> slots;
+      for (std::size_t i = 0; i < 3 * SLOTS; ++i) {
+        slots.push_back(pool.allocate());
+      }
+      THEN("Exactly three slabs should be in use") {
+        REQUIRE(pool.slabCount() == 3);
+      }
+      AND_WHEN("Freeing one slot and allocating again") {
+        void* freed = slots[SLOTS + 7];
+        pool.deallocate(freed);
+        THEN("The freed slot should be reused") {
+          REQUIRE(pool.allocate() == freed);
+          REQUIRE(pool.slabCount() == 3);
+        }
+      }
+      AND_WHEN("Freeing every slot of the middle slab") {
+        for (std::size_t i = SLOTS; i < 2 * SLOTS; ++i) {
+          pool.deallocate(slots[i]);
+        }
+        THEN("That slab should be released") {
+          REQUIRE(pool.slabCount() == 2);
+        }
+      }
+      AND_WHEN("Freeing every slot") {
+        for (void* slot : slots) {
+          pool.deallocate(slot);
+        }
+        THEN("One slab should be kept for reuse") {
+          REQUIRE(pool.slabCount() == 1);
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("Evacuating sparsely used slabs") {
+  GIVEN("A pool with four slabs, two of them mostly freed") {
+    NodePool<Block> pool;
+    const std::size_t SLOTS = NodePool<Block>::SLOTS_PER_SLAB;
+    std::vector<void*> slots;
+    for (std::size_t i = 0; i < 4 * SLOTS; ++i) {
+      slots.push_back(pool.allocate());
+    }
+    for (std::size_t i = 0; i < 4 * SLOTS; ++i) {
+      bool sparse = i / SLOTS == 1 || i / SLOTS == 3;
+      if (sparse && i % 10 != 0) {
+        pool.deallocate(slots[i]);
+        slots[i] = nullptr;
+      }
+    }
+    REQUIRE(pool.slabCount() == 4);
+    REQUIRE(pool.nextToEvacuate() == nullptr);
+
+    WHEN("Moving every slot the pool asks for") {
+      std::size_t moves = 0;
+      while (pool.beginEvacuation()) {
+        while (void* slot = pool.nextToEvacuate()) {
+          auto it = std::find(slots.begin(), slots.end(), slot);
+          REQUIRE(it != slots.end());
+          *it = pool.allocate();
+          REQUIRE(*it != slot);
+          pool.deallocate(slot);
+          ++moves;
+        }
+      }
+      THEN("The survivors should fit in fewer slabs") {
+        REQUIRE(moves > 0);
+        REQUIRE(pool.slabCount() == 3);
+      }
+    }
+  }
+}
@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "ParentlessRBTree.hpp"
+#include "RBTree.hpp"
+#include "catch.hpp"
+#include "sameShape.hpp"
+
+SCENARIO("A tree without parent links behaves like the one with them") {
+  GIVEN("An empty tree") {
+    ParentlessRBTree<int> rb;
+    THEN("min() and max() should throw") {
+      CHECK_THROWS(rb.min());
+      CHECK_THROWS(rb.max());
+    }
+    THEN("height should be -1") { REQUIRE(rb.height() == -1); }
+    THEN("deleteNode(42) should return false") { REQUIRE(!rb.deleteNode(42)); }
+  }
+
+  GIVEN("Both trees receiving the same shuffled inserts") {
+    auto shuffler = std::default_random_engine(42);
+    const int ITERATIONS = 300;
+    ParentlessRBTree<int> parentless;
+    RBTree<int> reference;
+    std::vector<int> v(ITERATIONS);
+    std::iota(std::begin(v), std::end(v), -ITERATIONS / 2);
+    std::shuffle(v.begin(), v.end(), shuffler);
+    for (int i : v) {
+      REQUIRE(parentless.addNode(i) == reference.addNode(i));
+      REQUIRE(sameShape(parentless, reference));
+    }
+    REQUIRE(!parentless.addNode(v[0]));
+
+    THEN("The elements should come out sorted") {
+      REQUIRE(parentless.inOrder() == reference.inOrder());
+      REQUIRE(parentless.min() == -ITERATIONS / 2);
+      REQUIRE(parentless.max() == ITERATIONS / 2 - 1);
+      REQUIRE(parentless.find(0));
+      REQUIRE(!parentless.find(ITERATIONS));
+    }
+
+    WHEN("Deleting every value in another order") {
+      std::shuffle(v.begin(), v.end(), shuffler);
+      for (int i : v) {
+        INFO("Deleting: " << i);
+        REQUIRE(parentless.deleteNode(i) == reference.deleteNode(i));
+        REQUIRE(sameShape(parentless, reference));
+      }
+      THEN("The tree should be empty") {
+        REQUIRE(parentless.size() == 0);
+        REQUIRE(parentless.height() == -1);
+      }
+    }
+
+    WHEN("Deleting sequentially from both ends") {
+      for (int i = 0; i < ITERATIONS / 2; ++i) {
+        REQUIRE(parentless.deleteNode(-ITERATIONS / 2 + i));
+        REQUIRE(reference.deleteNode(-ITERATIONS / 2 + i));
+        REQUIRE(parentless.deleteNode(ITERATIONS / 2 - 1 - i));
+        REQUIRE(reference.deleteNode(ITERATIONS / 2 - 1 - i));
+        REQUIRE(sameShape(parentless, reference));
+      }
+      THEN("The tree should be empty") { REQUIRE(parentless.size() == 0); }
+    }
+  }
+}
@@ -1,8 +1,11 @@
 #include <algorithm>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <numeric>
 #include <random>
+#include <set>
 
 #include "RBReader.hpp"
 #include "RBTree.hpp"
@@ -28,6 +31,10 @@ void STANDARD_TEST_CASES(RBTree<T>& rb, RBReader<T> reader, int count) {
 
   THEN("The nil node should be black") { REQUIRE(reader.nilIsBlack()); }
 
+  THEN("The shared nil node should be untouched") {
+    REQUIRE(reader.nilIsUntouched());
+  }
+
   THEN("All Red nodes should have black children") {
     REQUIRE(reader.redNodesHaveBlackChildren());
   }
@@ -40,6 +47,18 @@ void STANDARD_TEST_CASES(RBTree<T>& rb, RBReader<T> reader, int count) {
     REQUIRE(reader.noDuplicateElements());
   }
 
+  THEN("heightBounds() should follow the black height and bracket height()") {
+    auto bounds = rb.heightBounds();
+    REQUIRE(bounds.first == reader.blackHeight() - 1);
+    REQUIRE(bounds.second == 2 * reader.blackHeight() - 1);
+    REQUIRE(bounds.first <= rb.height());
+    REQUIRE(rb.height() <= bounds.second);
+  }
+
+  THEN("height() should match a count of the levels") {
+    REQUIRE(rb.height() == reader.height());
+  }
+
   THEN("The paths produced by pathFromRoot() should be correct") {
     REQUIRE(reader.pathToAncestorsCorrect());
   }
@@ -253,6 +272,27 @@ SCENARIO("Random inserts and deletes sequentially") {
   }
 }
 
+SCENARIO("Keeping height() up to date") {
+  GIVEN("A tree under a random mix of inserts and deletes") {
+    std::mt19937 gen(26);
+    std::uniform_int_distribution<int> key(0, 499);
+    RBTree<int> rb;
+    RBReader<int> reader(&rb);
+    THEN("height() should match a count of the levels after every change") {
+      for (int i = 0; i < 5000; ++i) {
+        int value = key(gen);
+        if (i % 3 == 0) {
+          rb.deleteNode(value);
+        } else {
+          rb.addNode(value);
+        }
+        INFO(fmt::format("Step {}, value {}", i, value));
+        REQUIRE(rb.height() == reader.height());
+      }
+    }
+  }
+}
+
 SCENARIO("Filling the tree with something other than numbers") {
   GIVEN("An empty tree") {
     auto shuffler = std::default_random_engine(42);
@@ -285,4 +325,1439 @@ SCENARIO("Filling the tree with something other than numbers") {
       }
     }
   }
-}
\ No newline at end of file
+}
+SCENARIO("Traversing the tree without copying it into a vector") {
+  GIVEN("A tree holding 0 - 99 inserted in random order") {
+    auto shuffler = std::default_random_engine(42);
+    const int ITERATIONS = 100;
+    RBTree<int> rb;
+    std::vector<int> v(ITERATIONS);
+    std::iota(std::begin(v), std::end(v), 0);
+    std::shuffle(v.begin(), v.end(), shuffler);
+    for (int i : v) {
+      rb.addNode(i);
+    }
+    std::sort(v.begin(), v.end());
+
+    THEN("size() should return 100") { REQUIRE(rb.size() == ITERATIONS); }
+    THEN("forEach() should visit every element in ascending order") {
+      std::vector<int> visited;
+      REQUIRE(rb.forEach([&](const int& e) { visited.push_back(e); }));
+      REQUIRE(visited == v);
+    }
+    THEN("forEachReverse() should visit every element in descending order") {
+      std::vector<int> visited;
+      REQUIRE(rb.forEachReverse([&](const int& e) { visited.push_back(e); }));
+      REQUIRE(visited == std::vector<int>(v.rbegin(), v.rend()));
+    }
+    THEN("forEach() should stop as soon as the visitor returns false") {
+      std::vector<int> visited;
+      REQUIRE(!rb.forEach([&](const int& e) {
+        visited.push_back(e);
+        return e < 9;
+      }));
+      REQUIRE(visited == std::vector<int>(v.begin(), v.begin() + 10));
+    }
+    THEN("inOrderInto() should write the same sequence as inOrder()") {
+      std::vector<int> written(ITERATIONS);
+      REQUIRE(rb.inOrderInto(written.begin()) == written.end());
+      REQUIRE(written == rb.inOrder());
+    }
+    THEN("inOrder() on an expiring tree should move the elements out") {
+      REQUIRE(std::move(rb).inOrder() == v);
+      REQUIRE(rb.size() == 0);
+      REQUIRE(rb.height() == -1);
+      REQUIRE(!rb.find(0));
+      AND_THEN("The tree should still be usable") {
+        rb.addNode(7);
+        REQUIRE(rb.inOrder() == std::vector<int>{7});
+      }
+    }
+  }
+}
+
+SCENARIO("Collecting root paths into a caller-supplied buffer") {
+  GIVEN("A tree holding 0 - 10 inserted sequentially") {
+    RBTree<int> rb;
+    for (int i = 0; i < 11; ++i) {
+      rb.addNode(i);
+    }
+    THEN("pathFromRoot() should hold the ancestors, but not the element") {
+      REQUIRE(rb.pathFromRoot(10) == std::vector<int>{3, 5, 7, 9});
+      REQUIRE(rb.pathFromRoot(0) == std::vector<int>{3, 1});
+    }
+    THEN("pathFromRoot(3) should only hold the root") {
+      REQUIRE(rb.pathFromRoot(3) == std::vector<int>{3});
+    }
+    WHEN("Appending paths to a buffer that already holds data") {
+      std::vector<int> path{-1};
+      THEN("A found element should have its path appended") {
+        REQUIRE(rb.pathFromRoot(4, path));
+        REQUIRE(path == std::vector<int>{-1, 3, 5});
+      }
+      THEN("A missing element should leave the buffer untouched") {
+        REQUIRE(!rb.pathFromRoot(42, path));
+        REQUIRE(path == std::vector<int>{-1});
+      }
+      THEN("Reusing the buffer should not reallocate it") {
+        path.reserve(16);
+        const int* data = path.data();
+        for (int i = 0; i < 11; ++i) {
+          path.resize(1);
+          REQUIRE(rb.pathFromRoot(i, path));
+          REQUIRE(std::vector<int>(path.begin() + 1, path.end()) ==
+                  rb.pathFromRoot(i));
+        }
+        REQUIRE(path.data() == data);
+      }
+    }
+  }
+}
+
+SCENARIO("Prefetching does not change the results of descents") {
+  auto mode = GENERATE(Prefetch::NONE, Prefetch::CHILDREN,
+                       Prefetch::GRANDCHILDREN);
+  GIVEN("A tree with prefetching configured") {
+    auto shuffler = std::default_random_engine(42);
+    const int ITERATIONS = 200;
+    RBTree<int> rb;
+    RBReader<int> reader(&rb);
+    rb.setPrefetch(mode);
+    std::vector<int> v(ITERATIONS);
+    std::iota(std::begin(v), std::end(v), 0);
+    std::shuffle(v.begin(), v.end(), shuffler);
+    WHEN("Inserting values and deleting every other one") {
+      for (int i : v) {
+        REQUIRE(rb.addNode(i));
+        REQUIRE(!rb.addNode(i));
+      }
+      for (int i = 0; i < ITERATIONS; i += 2) {
+        REQUIRE(rb.deleteNode(i));
+        REQUIRE(!rb.deleteNode(i));
+      }
+      STANDARD_TEST_CASES<int>(rb, reader, ITERATIONS / 2);
+      THEN("find() should only report the odd values") {
+        for (int i = -1; i <= ITERATIONS; ++i) {
+          REQUIRE(rb.find(i) == (i > 0 && i % 2 == 1 && i < ITERATIONS));
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("Looking up many keys at once") {
+  GIVEN("A tree holding the even numbers 0 - 998") {
+    auto shuffler = std::default_random_engine(42);
+    RBTree<int> rb;
+    std::vector<int> v(500);
+    std::generate(v.begin(), v.end(), [n = 0]() mutable { return 2 * n++; });
+    std::shuffle(v.begin(), v.end(), shuffler);
+    for (int i : v) {
+      rb.addNode(i);
+    }
+    WHEN("Looking up -10 - 1009 in random order with findBatch()") {
+      std::vector<int> keys(1020);
+      std::iota(keys.begin(), keys.end(), -10);
+      std::shuffle(keys.begin(), keys.end(), shuffler);
+      std::vector<bool> found;
+      rb.findBatch(keys, found);
+      THEN("Every result should match find()") {
+        REQUIRE(found.size() == keys.size());
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+          REQUIRE(found[i] == rb.find(keys[i]));
+        }
+      }
+    }
+    WHEN("Looking up fewer keys than there are lanes") {
+      std::vector<int> keys{4, 5, 998, 1000};
+      std::vector<bool> found{true};
+      rb.findBatch(keys, found);
+      THEN("The results should replace the old contents of out") {
+        REQUIRE(found == std::vector<bool>{true, false, true, false});
+      }
+    }
+    WHEN("Looking up an empty batch") {
+      std::vector<bool> found{true};
+      rb.findBatch({}, found);
+      THEN("out should be empty") { REQUIRE(found.empty()); }
+    }
+  }
+  GIVEN("An empty tree") {
+    RBTree<int> rb;
+    std::vector<bool> found;
+    rb.findBatch({1, 2, 3}, found);
+    THEN("Nothing should be found") {
+      REQUIRE(found == std::vector<bool>{false, false, false});
+    }
+  }
+}
+
+SCENARIO("Looking up a sorted set of keys") {
+  GIVEN("A tree holding the multiples of 3 from 0 - 297") {
+    auto shuffler = std::default_random_engine(42);
+    RBTree<int> rb;
+    std::vector<int> v(100);
+    std::generate(v.begin(), v.end(), [n = 0]() mutable { return 3 * n++; });
+    std::shuffle(v.begin(), v.end(), shuffler);
+    for (int i : v) {
+      rb.addNode(i);
+    }
+    WHEN("Probing every number from -5 - 305 with findSorted()") {
+      std::vector<int> keys(311);
+      std::iota(keys.begin(), keys.end(), -5);
+      std::vector<bool> found;
+      rb.findSorted(keys.begin(), keys.end(), std::back_inserter(found));
+      THEN("Every result should match find()") {
+        REQUIRE(found.size() == keys.size());
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+          REQUIRE(found[i] == rb.find(keys[i]));
+        }
+      }
+    }
+    WHEN("Probing a sparse sorted set with repeated keys") {
+      std::vector<int> keys{-1, 0, 0, 1, 3, 150, 150, 151, 297, 297, 400};
+      std::vector<bool> found(keys.size());
+      auto end = rb.findSorted(keys.begin(), keys.end(), found.begin());
+      THEN("Every result should match find()") {
+        REQUIRE(end == found.end());
+        REQUIRE(found == std::vector<bool>{false, true, true, false, true,
+                                           true, true, false, true, true,
+                                           false});
+      }
+    }
+  }
+  GIVEN("An empty tree") {
+    RBTree<int> rb;
+    std::vector<int> keys{1, 2};
+    std::vector<bool> found;
+    rb.findSorted(keys.begin(), keys.end(), std::back_inserter(found));
+    THEN("Nothing should be found") {
+      REQUIRE(found == std::vector<bool>{false, false});
+    }
+  }
+}
+
+SCENARIO("Storing the colour in the parent link") {
+  GIVEN("A standard and a compact tree receiving the same operations") {
+    auto shuffler = std::default_random_engine(42);
+    const int ITERATIONS = 200;
+    RBTree<long> standard;
+    RBTree<long, NodeLayout::COMPACT> compact;
+    std::vector<long> v(ITERATIONS);
+    std::iota(std::begin(v), std::end(v), -ITERATIONS / 2);
+    std::shuffle(v.begin(), v.end(), shuffler);
+    for (long i : v) {
+      REQUIRE(standard.addNode(i) == compact.addNode(i));
+    }
+    THEN("Both trees should have the same shape and colours") {
+      REQUIRE(compact.ToGraphviz() == standard.ToGraphviz());
+      REQUIRE(compact.heightBounds() == standard.heightBounds());
+      REQUIRE(compact.height() == standard.height());
+    }
+    WHEN("Deleting half of the values again") {
+      std::shuffle(v.begin(), v.end(), shuffler);
+      for (int i = 0; i < ITERATIONS / 2; ++i) {
+        REQUIRE(standard.deleteNode(v[i]) == compact.deleteNode(v[i]));
+      }
+      THEN("Both trees should still have the same shape and colours") {
+        REQUIRE(compact.ToGraphviz() == standard.ToGraphviz());
+        REQUIRE(compact.inOrder() == standard.inOrder());
+        REQUIRE(compact.pathFromRoot(v.back()) ==
+                standard.pathFromRoot(v.back()));
+      }
+      AND_WHEN("Deleting the rest") {
+        for (int i = ITERATIONS / 2; i < ITERATIONS; ++i) {
+          REQUIRE(compact.deleteNode(v[i]));
+        }
+        THEN("The compact tree should be empty") {
+          REQUIRE(compact.size() == 0);
+          REQUIRE(compact.height() == -1);
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("Relaying out the nodes of a tree") {
+  GIVEN("A tree that has seen inserts and deletes") {
+    auto shuffler = std::default_random_engine(42);
+    const int ITERATIONS = 3000;
+    RBTree<int> rb;
+    RBTree<int, NodeLayout::COMPACT> compact;
+    std::vector<int> v(ITERATIONS);
+    std::iota(std::begin(v), std::end(v), 0);
+    std::shuffle(v.begin(), v.end(), shuffler);
+    for (int i : v) {
+      rb.addNode(i);
+      compact.addNode(i);
+    }
+    for (int i = 0; i < ITERATIONS; i += 3) {
+      rb.deleteNode(v[i]);
+      compact.deleteNode(v[i]);
+    }
+    std::string before = rb.ToGraphviz();
+    auto bounds = rb.heightBounds();
+    int height = rb.height();
+    rb.relayout();
+    compact.relayout();
+
+    THEN("The shape, colours and contents should not change") {
+      REQUIRE(rb.ToGraphviz() == before);
+      REQUIRE(compact.ToGraphviz() == before);
+      REQUIRE(rb.heightBounds() == bounds);
+      REQUIRE(rb.height() == height);
+      REQUIRE(rb.find(v[1]));
+      REQUIRE(!rb.find(v[0]));
+    }
+    WHEN("Modifying the tree afterwards") {
+      for (int i = 0; i < ITERATIONS; ++i) {
+        REQUIRE(rb.addNode(v[i]) == (i % 3 == 0));
+        REQUIRE(compact.addNode(v[i]) == (i % 3 == 0));
+      }
+      for (int i = 0; i < ITERATIONS; i += 2) {
+        REQUIRE(rb.deleteNode(v[i]));
+        REQUIRE(compact.deleteNode(v[i]));
+      }
+      THEN("Both layouts should still agree") {
+        REQUIRE(compact.ToGraphviz() == rb.ToGraphviz());
+        REQUIRE(rb.size() == ITERATIONS / 2);
+      }
+    }
+  }
+
+  GIVEN("An empty tree") {
+    RBTree<int> rb;
+    rb.relayout();
+    THEN("It should stay empty") {
+      REQUIRE(rb.size() == 0);
+      REQUIRE(rb.height() == -1);
+      REQUIRE(rb.addNode(1));
+    }
+  }
+}
+
+SCENARIO("Compacting the nodes of a tree after mass deletes") {
+  GIVEN("A large tree with most of its elements deleted") {
+    auto shuffler = std::default_random_engine(42);
+    const int ITERATIONS = 20000;
+    RBTree<int> rb;
+    std::vector<int> v(ITERATIONS);
+    std::iota(std::begin(v), std::end(v), 0);
+    std::shuffle(v.begin(), v.end(), shuffler);
+    for (int i : v) {
+      rb.addNode(i);
+    }
+    std::size_t fullSlabs = rb.slabCount();
+    for (int i = 0; i < ITERATIONS; ++i) {
+      if (i % 8 != 0) {
+        rb.deleteNode(v[i]);
+      }
+    }
+    std::string before = rb.ToGraphviz();
+    REQUIRE(rb.slabCount() == fullSlabs);
+
+    WHEN("Compacting a few nodes at a time") {
+      int steps = 1;
+      while (!rb.compactStep(100)) {
+        ++steps;
+      }
+      THEN("The tree should be unchanged but use fewer slabs") {
+        REQUIRE(steps > 1);
+        REQUIRE(rb.ToGraphviz() == before);
+        REQUIRE(rb.slabCount() <= fullSlabs / 8 + 2);
+        REQUIRE(rb.compactStep(100));
+      }
+      AND_WHEN("Modifying the tree afterwards") {
+        for (int i = 0; i < ITERATIONS; ++i) {
+          REQUIRE(rb.addNode(v[i]) == (i % 8 != 0));
+        }
+        THEN("It should hold every element again") {
+          REQUIRE(rb.size() == ITERATIONS);
+          REQUIRE(rb.heightBounds().second >= rb.height());
+        }
+      }
+    }
+    WHEN("Compacting with a time budget") {
+      while (!rb.compactFor(std::chrono::microseconds(50))) {
+      }
+      THEN("The tree should be unchanged but use fewer slabs") {
+        REQUIRE(rb.ToGraphviz() == before);
+        REQUIRE(rb.slabCount() <= fullSlabs / 8 + 2);
+      }
+    }
+  }
+}
+
+namespace {
+/**
+ * An int whose copy constructor throws once copiesLeft runs out. Its move
+ * constructor is not noexcept, so containers copy it where a move could fail
+ * halfway.
+ */
+struct Fragile {
+  static int copiesLeft;
+  int value = 0;
+  Fragile(int value) : value(value) {}
+  Fragile(const Fragile& other) : value(other.value) {
+    if (copiesLeft-- == 0) {
+      throw std::string("copy failed");
+    }
+  }
+  Fragile(Fragile&& other) : value(other.value) {}
+  Fragile& operator=(const Fragile& other) = default;
+  Fragile& operator=(Fragile&& other) = default;
+  bool operator<(const Fragile& other) const { return value < other.value; }
+  bool operator==(const Fragile& other) const { return value == other.value; }
+};
+int Fragile::copiesLeft = 0;
+}  // namespace
+
+SCENARIO("Keeping small sets in a sorted array") {
+  GIVEN("A tree with a small limit of 16 and one without") {
+    auto shuffler = std::default_random_engine(42);
+    const std::size_t LIMIT = 16;
+    RBTree<int> rb;
+    rb.setSmallLimit(LIMIT);
+    RBTree<int> reference;
+    for (int i = 0; i < 10; ++i) {
+      rb.addNode(i);
+      reference.addNode(i);
+    }
+    THEN("No node memory should be used") {
+      REQUIRE(rb.slabCount() == 0);
+      REQUIRE(rb.inOrder() == reference.inOrder());
+      REQUIRE(rb.min() == 0);
+      REQUIRE(rb.max() == 9);
+    }
+    WHEN("Growing and shrinking across the limit repeatedly") {
+      std::uniform_int_distribution<int> dist(0, 40);
+      for (int k = 0; k < 2000; ++k) {
+        int key = dist(shuffler);
+        if (k % 200 < 100) {
+          REQUIRE(rb.addNode(key) == reference.addNode(key));
+        } else {
+          REQUIRE(rb.deleteNode(key) == reference.deleteNode(key));
+        }
+        REQUIRE(rb.size() == reference.size());
+        REQUIRE(rb.find(key) == reference.find(key));
+      }
+      THEN("Both trees should hold the same elements") {
+        REQUIRE(rb.inOrder() == reference.inOrder());
+        std::vector<int> reversed;
+        rb.forEachReverse([&](int e) { reversed.push_back(e); });
+        REQUIRE(std::equal(reversed.rbegin(), reversed.rend(),
+                           reference.inOrder().begin()));
+        std::vector<int> keys(41);
+        std::iota(keys.begin(), keys.end(), 0);
+        std::vector<bool> found, expected;
+        rb.findBatch(keys, found);
+        reference.findBatch(keys, expected);
+        REQUIRE(found == expected);
+      }
+    }
+    WHEN("Growing past the limit") {
+      for (int i = 10; i < 40; ++i) {
+        rb.addNode(i);
+      }
+      THEN("The elements should move into nodes") {
+        REQUIRE(rb.slabCount() == 1);
+        REQUIRE(rb.size() == 40);
+        REQUIRE(rb.find(39));
+      }
+      AND_WHEN("Shrinking to half the limit") {
+        for (int i = 39; i >= static_cast<int>(LIMIT / 2); --i) {
+          REQUIRE(rb.deleteNode(i));
+        }
+        THEN("They should move back into the array") {
+          REQUIRE(rb.slabCount() == 0);
+          REQUIRE(rb.size() == LIMIT / 2);
+          REQUIRE(rb.inOrder() == std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7});
+        }
+      }
+    }
+    WHEN("Asking about the shape of the tree") {
+      std::vector<int> path = rb.pathFromRoot(9);
+      std::pair<int, int> bounds = rb.heightBounds();
+      int height = rb.height();
+      std::string graph = rb.ToGraphviz();
+      THEN("It should describe a balanced tree without moving into nodes") {
+        REQUIRE(rb.slabCount() == 0);
+        REQUIRE(path == std::vector<int>{5, 8});
+        REQUIRE(rb.pathFromRoot(5) == std::vector<int>{5});
+        REQUIRE(rb.pathFromRoot(42).empty());
+        REQUIRE(bounds == std::pair<int, int>{2, 5});
+        REQUIRE(height == 3);
+        REQUIRE(graph.find("[label=\"5\"") != std::string::npos);
+      }
+      AND_WHEN("Moving the elements into nodes") {
+        rb.setSmallLimit(0);
+        THEN("The nodes should take exactly that shape") {
+          REQUIRE(rb.slabCount() == 1);
+          REQUIRE(rb.pathFromRoot(9) == path);
+          REQUIRE(rb.heightBounds() == bounds);
+          REQUIRE(rb.height() == height);
+          REQUIRE(rb.ToGraphviz() == graph);
+          RBReader<int> reader(&rb);
+          REQUIRE(reader.allLeavesHaveSameNumberOfBlackAncestors());
+          REQUIRE(reader.redNodesHaveBlackChildren());
+        }
+      }
+    }
+  }
+
+  GIVEN("A small tree of strings") {
+    RBTree<std::string> rb;
+    rb.setSmallLimit(8);
+    for (const char* word : {"pear", "apple", "fig"}) {
+      rb.addNode(word);
+    }
+    THEN("Lookups should use the sorted array") {
+      REQUIRE(rb.find("fig"));
+      REQUIRE(!rb.find("kiwi"));
+      REQUIRE(!rb.addNode("fig"));
+      REQUIRE(rb.inOrder() ==
+              std::vector<std::string>{"apple", "fig", "pear"});
+    }
+    WHEN("Turning the limit off again") {
+      rb.setSmallLimit(0);
+      THEN("The elements should move into nodes") {
+        REQUIRE(rb.slabCount() == 1);
+        REQUIRE(rb.size() == 3);
+        REQUIRE(rb.find("pear"));
+      }
+    }
+  }
+
+  GIVEN("A full small tree whose elements fail to copy") {
+    Fragile::copiesLeft = 1000;
+    RBTree<Fragile> rb;
+    rb.setSmallLimit(8);
+    for (int i = 0; i < 8; ++i) {
+      rb.addNode(Fragile(i * 2));
+    }
+    WHEN("Growing past the limit fails halfway through moving into nodes") {
+      Fragile::copiesLeft = 3;
+      CHECK_THROWS(rb.addNode(Fragile(5)));
+      Fragile::copiesLeft = 1000;
+      THEN("The tree should be left as it was") {
+        REQUIRE(rb.size() == 8);
+        REQUIRE(!rb.find(Fragile(5)));
+        std::vector<int> values;
+        rb.forEach([&](const Fragile& e) { values.push_back(e.value); });
+        REQUIRE(values == std::vector<int>{0, 2, 4, 6, 8, 10, 12, 14});
+      }
+      AND_WHEN("Trying again") {
+        REQUIRE(rb.addNode(Fragile(5)));
+        THEN("The elements should move into nodes") {
+          REQUIRE(rb.slabCount() == 1);
+          REQUIRE(rb.size() == 9);
+          REQUIRE(rb.find(Fragile(5)));
+          REQUIRE(rb.find(Fragile(14)));
+        }
+      }
+    }
+  }
+}
+
+namespace {
+/** An int that counts how often it is copied */
+struct Counted {
+  static int copies;
+  int value = 0;
+  Counted() = default;
+  Counted(int value) : value(value) {}
+  Counted(const Counted& other) : value(other.value) { ++copies; }
+  Counted& operator=(const Counted& other) {
+    value = other.value;
+    ++copies;
+    return *this;
+  }
+  bool operator<(const Counted& other) const { return value < other.value; }
+  bool operator==(const Counted& other) const { return value == other.value; }
+};
+int Counted::copies = 0;
+}  // namespace
+
+SCENARIO("Moving elements between trees with node handles") {
+  GIVEN("An active tree holding 0 - 99 and an empty expired tree") {
+    auto active = std::make_unique<RBTree<Counted>>();
+    RBTree<Counted> expired;
+    for (int i = 0; i < 100; ++i) {
+      active->addNode(i);
+    }
+    WHEN("Moving the even elements over") {
+      Counted::copies = 0;
+      for (int i = 0; i < 100; i += 2) {
+        auto handle = active->extract(i);
+        REQUIRE(!handle.empty());
+        REQUIRE(handle.value().value == i);
+        REQUIRE(expired.insert(std::move(handle)));
+        REQUIRE(handle.empty());
+      }
+      THEN("No element should be copied and no node allocated") {
+        REQUIRE(Counted::copies == 0);
+        REQUIRE(expired.slabCount() == 0);
+        REQUIRE(active->size() == 50);
+        REQUIRE(expired.size() == 50);
+        REQUIRE(!active->find(0));
+        REQUIRE(expired.find(0));
+        REQUIRE(expired.heightBounds().second >= expired.height());
+      }
+      THEN("Extracting a missing element should give an empty handle") {
+        REQUIRE(active->extract(0).empty());
+        REQUIRE(!active->insert(active->extract(1000)));
+      }
+      THEN("A duplicate should be refused and stay in the handle") {
+        active->addNode(0);
+        auto handle = active->extract(0);
+        REQUIRE(!expired.insert(std::move(handle)));
+        REQUIRE(!handle.empty());
+        REQUIRE(active->insert(std::move(handle)));
+        REQUIRE(active->find(0));
+      }
+      AND_WHEN("Compacting and then destroying the active tree") {
+        for (int i = 1; i < 100; i += 2) {
+          REQUIRE(active->deleteNode(i));
+        }
+        active->compactStep(1000);
+        active.reset();
+        THEN("The moved elements should still be usable") {
+          for (int i = 0; i < 100; i += 2) {
+            REQUIRE(expired.find(i));
+          }
+          for (int i = 0; i < 100; i += 4) {
+            REQUIRE(expired.deleteNode(i));
+          }
+          REQUIRE(expired.size() == 25);
+        }
+      }
+    }
+    WHEN("Changing the key of an extracted element") {
+      auto handle = active->extract(5);
+      handle.value().value = 500;
+      REQUIRE(active->insert(std::move(handle)));
+      THEN("It should be found under the new key") {
+        REQUIRE(active->find(500));
+        REQUIRE(!active->find(5));
+        REQUIRE(active->max().value == 500);
+      }
+    }
+    WHEN("Dropping a handle") {
+      { auto handle = active->extract(7); }
+      THEN("The element should be gone") {
+        REQUIRE(!active->find(7));
+        REQUIRE(active->size() == 99);
+      }
+    }
+  }
+}
+
+namespace {
+/**
+ * Checks the red-black properties and the maintained black height of rb, and
+ * that it holds exactly expected.
+ */
+void requireValidTree(RBTree<int>& rb, const std::vector<int>& expected) {
+  RBReader<int> reader(&rb);
+  REQUIRE(rb.size() == expected.size());
+  REQUIRE(reader.cntNodes() == static_cast<int>(expected.size()));
+  REQUIRE(reader.noLeavesAreNull());
+  REQUIRE(reader.nilIsUntouched());
+  REQUIRE(reader.redNodesHaveBlackChildren());
+  REQUIRE(reader.allLeavesHaveSameNumberOfBlackAncestors());
+  REQUIRE(rb.heightBounds().first == reader.blackHeight() - 1);
+  REQUIRE(rb.height() == reader.height());
+  REQUIRE(rb.inOrder() == expected);
+}
+}  // namespace
+
+SCENARIO("Merging trees by relinking their nodes") {
+  std::mt19937 gen(7);
+  GIVEN("Pairs of trees with disjoint ranges of many sizes") {
+    THEN("Merging either into the other should join them into a valid tree") {
+      for (int low : {1, 2, 3, 10, 100, 1000}) {
+        for (int high : {1, 2, 7, 100, 1000}) {
+          for (bool intoLow : {true, false}) {
+            RBTree<int> lowTree;
+            RBTree<int> highTree;
+            std::vector<int> all(low + high);
+            std::iota(all.begin(), all.end(), 0);
+            std::vector<int> shuffled = all;
+            std::shuffle(shuffled.begin(), shuffled.end(), gen);
+            for (int value : shuffled) {
+              (value < low ? lowTree : highTree).addNode(value);
+            }
+            std::size_t slabs = lowTree.slabCount() + highTree.slabCount();
+            RBTree<int>& into = intoLow ? lowTree : highTree;
+            RBTree<int>& from = intoLow ? highTree : lowTree;
+            into.merge(from);
+            INFO(fmt::format("{} + {}, into {}", low, high,
+                             intoLow ? "low" : "high"));
+            requireValidTree(into, all);
+            requireValidTree(from, {});
+            REQUIRE(into.slabCount() <= slabs);
+            from.addNode(-1);
+            REQUIRE(from.find(-1));
+            for (int value : shuffled) {
+              REQUIRE(into.deleteNode(value));
+            }
+            requireValidTree(into, {});
+          }
+        }
+      }
+    }
+  }
+
+  GIVEN("A tree with the multiples of 2 and one with the multiples of 3") {
+    RBTree<Counted> twos;
+    auto threes = std::make_unique<RBTree<Counted>>();
+    for (int i = 0; i < 3000; i += 2) {
+      twos.addNode(i);
+    }
+    for (int i = 0; i < 3000; i += 3) {
+      threes->addNode(i);
+    }
+    WHEN("Merging the threes into the twos") {
+      Counted::copies = 0;
+      twos.merge(*threes);
+      THEN("The multiples of 6 should stay behind and nothing be copied") {
+        REQUIRE(Counted::copies == 0);
+        REQUIRE(twos.size() == 2000);
+        REQUIRE(threes->size() == 500);
+        for (int i = 0; i < 3000; ++i) {
+          REQUIRE(twos.find(i) == (i % 2 == 0 || i % 3 == 0));
+          REQUIRE(threes->find(i) == (i % 6 == 0));
+        }
+        REQUIRE(twos.heightBounds().second >= twos.height());
+        REQUIRE(threes->heightBounds().second >= threes->height());
+      }
+      AND_WHEN("Destroying the threes and compacting the twos") {
+        threes.reset();
+        for (int i = 0; i < 3000; i += 2) {
+          REQUIRE(twos.deleteNode(i));
+        }
+        while (!twos.compactStep(1000)) {
+        }
+        THEN("The merged nodes should still be usable") {
+          REQUIRE(twos.size() == 500);
+          REQUIRE(twos.min().value == 3);
+          REQUIRE(twos.max().value == 2997);
+        }
+      }
+    }
+  }
+
+  GIVEN("A large tree and a few overlapping elements in another") {
+    RBTree<int> large;
+    RBTree<int> few;
+    std::vector<int> expected;
+    for (int i = 0; i < 1000; ++i) {
+      large.addNode(i * 10);
+      expected.push_back(i * 10);
+    }
+    for (int i : {5, 500, 995, 4321}) {
+      few.addNode(i);
+    }
+    expected.insert(expected.end(), {5, 995, 4321});
+    std::sort(expected.begin(), expected.end());
+    WHEN("Merging the few into the large tree") {
+      large.merge(few);
+      THEN("Only the duplicate should be left behind") {
+        requireValidTree(large, expected);
+        requireValidTree(few, {500});
+      }
+    }
+  }
+
+  GIVEN("Trees keeping their elements in sorted arrays") {
+    RBTree<int> left;
+    RBTree<int> right;
+    left.setSmallLimit(8);
+    right.setSmallLimit(8);
+    for (int i = 0; i < 6; ++i) {
+      left.addNode(i);
+      right.addNode(i + 3);
+    }
+    WHEN("Merging them") {
+      left.merge(right);
+      THEN("The union should end up in one and the overlap in the other") {
+        requireValidTree(left, {0, 1, 2, 3, 4, 5, 6, 7, 8});
+        REQUIRE(right.inOrder() == std::vector<int>{3, 4, 5});
+      }
+    }
+  }
+}
+
+namespace {
+/**
+ * No default constructor, and counts how often it is copied and moved.
+ */
+struct Payload {
+  static int copies;
+  static int moves;
+  int key;
+  std::string data;
+  Payload(int key, std::string data) : key(key), data(std::move(data)) {}
+  Payload(const Payload& other) : key(other.key), data(other.data) {
+    ++copies;
+  }
+  Payload(Payload&& other) noexcept
+      : key(other.key), data(std::move(other.data)) {
+    ++moves;
+  }
+  Payload& operator=(const Payload& other) {
+    key = other.key;
+    data = other.data;
+    ++copies;
+    return *this;
+  }
+  Payload& operator=(Payload&& other) noexcept {
+    key = other.key;
+    data = std::move(other.data);
+    ++moves;
+    return *this;
+  }
+  bool operator<(const Payload& other) const { return key < other.key; }
+  bool operator==(const Payload& other) const { return key == other.key; }
+};
+int Payload::copies = 0;
+int Payload::moves = 0;
+}  // namespace
+
+SCENARIO("Constructing elements in place") {
+  GIVEN("A tree of an element type without a default constructor") {
+    RBTree<Payload> rb;
+    Payload::copies = 0;
+    Payload::moves = 0;
+    WHEN("Emplacing elements") {
+      for (int i = 0; i < 100; ++i) {
+        REQUIRE(rb.emplace(i, std::string(100, 'x')));
+      }
+      THEN("They should be neither copied nor moved") {
+        REQUIRE(Payload::copies == 0);
+        REQUIRE(Payload::moves == 0);
+        REQUIRE(rb.size() == 100);
+        REQUIRE(rb.min().key == 0);
+        REQUIRE(rb.max().key == 99);
+        REQUIRE(rb.max().data == std::string(100, 'x'));
+      }
+      THEN("Emplacing a duplicate should fail and leave the original") {
+        REQUIRE(!rb.emplace(5, "other"));
+        REQUIRE(rb.size() == 100);
+        REQUIRE(rb.find(Payload(5, "")));
+        REQUIRE(rb.findPtr(Payload(5, ""))->data == std::string(100, 'x'));
+      }
+      AND_WHEN("Deleting, relaying out and compacting") {
+        for (int i = 0; i < 100; i += 3) {
+          REQUIRE(rb.deleteNode(Payload(i, "")));
+        }
+        rb.relayout();
+        while (!rb.compactStep(10)) {
+        }
+        THEN("The elements should be moved but never copied") {
+          REQUIRE(Payload::copies == 0);
+          REQUIRE(rb.size() == 66);
+          REQUIRE(rb.min().key == 1);
+          REQUIRE(rb.min().data == std::string(100, 'x'));
+        }
+      }
+    }
+    WHEN("Adding temporaries") {
+      REQUIRE(rb.addNode(Payload(1, "one")));
+      REQUIRE(!rb.addNode(Payload(1, "again")));
+      THEN("Each should be moved once and a duplicate not at all") {
+        REQUIRE(Payload::copies == 0);
+        REQUIRE(Payload::moves == 1);
+        REQUIRE(rb.min().data == "one");
+      }
+    }
+    WHEN("Keeping the elements in a sorted array") {
+      rb.setSmallLimit(8);
+      for (int i = 0; i < 20; ++i) {
+        REQUIRE(rb.emplace(i, "small"));
+      }
+      THEN("Moving to nodes should not copy them") {
+        REQUIRE(Payload::copies == 0);
+        REQUIRE(rb.size() == 20);
+        REQUIRE(rb.max().key == 19);
+      }
+    }
+  }
+}
+
+SCENARIO("Reading and updating stored elements in place") {
+  for (std::size_t limit : {0, 64}) {
+    GIVEN(fmt::format("A tree of keys with payloads and small limit {}",
+                      limit)) {
+      RBTree<Payload> rb;
+      rb.setSmallLimit(limit);
+      for (int i = 0; i < 50; ++i) {
+        rb.emplace(i, std::to_string(i));
+      }
+      THEN("findPtr() should give the stored element") {
+        const Payload* stored = rb.findPtr(Payload(7, ""));
+        REQUIRE(stored != nullptr);
+        REQUIRE(stored->data == "7");
+        REQUIRE(rb.findPtr(Payload(50, "")) == nullptr);
+      }
+      WHEN("Modifying the payload of an element") {
+        Payload::copies = 0;
+        bool found = rb.modify(Payload(7, ""), [](Payload& stored) {
+          stored.data += " updated";
+        });
+        THEN("The change should be visible without copying anything") {
+          REQUIRE(found);
+          REQUIRE(Payload::copies == 0);
+          REQUIRE(rb.findPtr(Payload(7, ""))->data == "7 updated");
+          REQUIRE(rb.size() == 50);
+        }
+      }
+      THEN("Modifying a missing element should not call fn") {
+        bool called = false;
+        REQUIRE(!rb.modify(Payload(-1, ""),
+                           [&](Payload&) { called = true; }));
+        REQUIRE(!called);
+      }
+    }
+  }
+}
+
+SCENARIO("Changing the key of an element") {
+  for (std::size_t limit : {0, 1000}) {
+    GIVEN(fmt::format("The multiples of 10 below 1000, small limit {}",
+                      limit)) {
+      RBTree<int> rb;
+      rb.setSmallLimit(limit);
+      std::vector<int> expected;
+      for (int i = 0; i < 1000; i += 10) {
+        rb.addNode(i);
+        expected.push_back(i);
+      }
+      WHEN("Moving a key between its neighbours") {
+        std::vector<int> path = rb.pathFromRoot(500);
+        REQUIRE(rb.rekey(500, 505));
+        THEN("The node should stay where it was") {
+          std::replace(path.begin(), path.end(), 500, 505);
+          REQUIRE(rb.pathFromRoot(505) == path);
+          REQUIRE(!rb.find(500));
+        }
+      }
+      WHEN("Moving keys past their neighbours") {
+        std::mt19937 gen(3);
+        std::uniform_int_distribution<int> dist(0, 99999);
+        for (int round = 0; round < 2000; ++round) {
+          int from = expected[gen() % expected.size()];
+          int to = dist(gen);
+          bool present =
+              std::find(expected.begin(), expected.end(), to) != expected.end();
+          REQUIRE(rb.rekey(from, to) == (!present || from == to));
+          if (!present) {
+            *std::find(expected.begin(), expected.end(), from) = to;
+          }
+        }
+        std::sort(expected.begin(), expected.end());
+        THEN("The tree should hold the new keys and stay valid") {
+          if (limit == 0) {
+            requireValidTree(rb, expected);
+          }
+          REQUIRE(rb.inOrder() == expected);
+        }
+      }
+      THEN("A missing key or a taken new key should be refused") {
+        std::string shape = rb.ToGraphviz();
+        REQUIRE(!rb.rekey(5, 6));
+        REQUIRE(!rb.rekey(10, 20));
+        REQUIRE(!rb.rekey(10, 990));
+        REQUIRE(rb.find(10));
+        REQUIRE(rb.size() == 100);
+        AND_THEN("The tree should not have been restructured") {
+          REQUIRE(rb.ToGraphviz() == shape);
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("Erasing ranges of elements") {
+  GIVEN("Trees holding 0 - n in random order") {
+    THEN("Erasing any range should keep a valid tree with the rest") {
+      std::mt19937 gen(11);
+      for (int n : {1, 2, 5, 17, 100, 1000}) {
+        std::vector<int> keys(n);
+        std::iota(keys.begin(), keys.end(), 0);
+        std::uniform_int_distribution<int> bound(-2, n + 2);
+        for (int round = 0; round < 20; ++round) {
+          RBTree<int> rb;
+          std::shuffle(keys.begin(), keys.end(), gen);
+          for (int key : keys) {
+            rb.addNode(key);
+          }
+          int lo = bound(gen);
+          int hi = round == 0 ? n : bound(gen);
+          std::vector<int> expected;
+          for (int i = 0; i < n; ++i) {
+            if (!(lo <= i && i < hi)) {
+              expected.push_back(i);
+            }
+          }
+          INFO(fmt::format("n = {}, erasing [{}, {})", n, lo, hi));
+          REQUIRE(rb.eraseRange(lo, hi) == n - expected.size());
+          requireValidTree(rb, expected);
+          for (int key : expected) {
+            REQUIRE(rb.deleteNode(key));
+          }
+          requireValidTree(rb, {});
+        }
+      }
+    }
+  }
+
+  GIVEN("A tree keeping its elements in a sorted array") {
+    RBTree<int> rb;
+    rb.setSmallLimit(16);
+    for (int i = 0; i < 10; ++i) {
+      rb.addNode(i);
+    }
+    WHEN("Erasing a range") {
+      REQUIRE(rb.eraseRange(2, 5) == 3);
+      THEN("Only the rest should remain") {
+        REQUIRE(rb.inOrder() == std::vector<int>{0, 1, 5, 6, 7, 8, 9});
+      }
+    }
+  }
+}
+
+SCENARIO("Erasing the elements that match a predicate") {
+  GIVEN("A tree holding 0 - 999") {
+    RBTree<int> rb;
+    for (int i = 0; i < 1000; ++i) {
+      rb.addNode(i);
+    }
+    WHEN("Erasing the few multiples of 97") {
+      REQUIRE(rb.eraseIf([](int i) { return i % 97 == 0; }) == 11);
+      THEN("They should be gone and the tree valid") {
+        std::vector<int> expected;
+        for (int i = 0; i < 1000; ++i) {
+          if (i % 97 != 0) {
+            expected.push_back(i);
+          }
+        }
+        requireValidTree(rb, expected);
+      }
+    }
+    WHEN("Erasing the many elements not divisible by 3") {
+      REQUIRE(rb.eraseIf([](int i) { return i % 3 != 0; }) == 666);
+      THEN("The rebuilt tree should be valid") {
+        std::vector<int> expected;
+        for (int i = 0; i < 1000; i += 3) {
+          expected.push_back(i);
+        }
+        requireValidTree(rb, expected);
+        REQUIRE(rb.deleteNode(999));
+        REQUIRE(rb.addNode(1000));
+      }
+    }
+    WHEN("Erasing everything") {
+      REQUIRE(rb.eraseIf([](int) { return true; }) == 1000);
+      THEN("The tree should be empty") { requireValidTree(rb, {}); }
+    }
+  }
+}
+
+SCENARIO("Deleting a batch of keys") {
+  for (std::size_t batchSize : {1, 20, 200, 900}) {
+    GIVEN(fmt::format("A tree holding 0 - 999 and {} random keys, some "
+                      "repeated or missing",
+                      batchSize)) {
+      std::mt19937 gen(static_cast<unsigned>(batchSize));
+      RBTree<int> rb;
+      std::vector<int> keys(1000);
+      std::iota(keys.begin(), keys.end(), 0);
+      std::shuffle(keys.begin(), keys.end(), gen);
+      for (int key : keys) {
+        rb.addNode(key);
+      }
+      std::uniform_int_distribution<int> dist(-50, 1049);
+      std::vector<int> batch;
+      for (std::size_t i = 0; i < batchSize; ++i) {
+        batch.push_back(dist(gen));
+      }
+      std::vector<int> expected;
+      for (int i = 0; i < 1000; ++i) {
+        if (std::find(batch.begin(), batch.end(), i) == batch.end()) {
+          expected.push_back(i);
+        }
+      }
+      WHEN("Deleting the batch") {
+        std::size_t deleted = rb.deleteBatch(batch.begin(), batch.end());
+        THEN("Exactly the keys in the tree should be gone") {
+          REQUIRE(deleted == 1000 - expected.size());
+          requireValidTree(rb, expected);
+          for (int key : expected) {
+            REQUIRE(rb.deleteNode(key));
+          }
+        }
+      }
+    }
+  }
+
+  GIVEN("A tree keeping its elements in a sorted array") {
+    RBTree<int> rb;
+    rb.setSmallLimit(16);
+    for (int i = 0; i < 10; ++i) {
+      rb.addNode(i);
+    }
+    WHEN("Deleting a batch") {
+      std::vector<int> batch{9, 3, 3, 42, 0};
+      REQUIRE(rb.deleteBatch(batch.begin(), batch.end()) == 3);
+      THEN("Only the rest should remain") {
+        REQUIRE(rb.inOrder() == std::vector<int>{1, 2, 4, 5, 6, 7, 8});
+      }
+    }
+  }
+}
+
+SCENARIO("Partitioning a tree by a predicate") {
+  for (int count : {0, 1, 2, 100, 3000}) {
+    for (int modulus : {1, 2, 7}) {
+      GIVEN(fmt::format("A tree holding 0 - {}, split on multiples of {}",
+                        count - 1, modulus)) {
+        auto source = std::make_unique<RBTree<int>>();
+        std::vector<int> keys(count);
+        std::iota(keys.begin(), keys.end(), 0);
+        std::vector<int> shuffled = keys;
+        std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(count));
+        for (int key : shuffled) {
+          source->addNode(key);
+        }
+        RBTree<int> matching;
+        RBTree<int> rest;
+        matching.addNode(-1);
+        std::vector<int> seen;
+        source->partition(
+            [&](int key) {
+              seen.push_back(key);
+              return key % modulus == 0;
+            },
+            matching, rest);
+        THEN("Each element should have moved to the right valid tree") {
+          REQUIRE(seen == keys);
+          std::vector<int> multiples;
+          std::vector<int> others;
+          for (int key : keys) {
+            (key % modulus == 0 ? multiples : others).push_back(key);
+          }
+          requireValidTree(*source, {});
+          requireValidTree(matching, multiples);
+          requireValidTree(rest, others);
+          REQUIRE(source->slabCount() == 0);
+        }
+        AND_WHEN("Destroying the source and changing both trees") {
+          source.reset();
+          for (int key : keys) {
+            REQUIRE((key % modulus == 0 ? matching : rest).deleteNode(key));
+          }
+          matching.addNode(1);
+          rest.addNode(2);
+          THEN("The moved nodes should still have been usable") {
+            requireValidTree(matching, {1});
+            requireValidTree(rest, {2});
+          }
+        }
+        AND_WHEN("Thinning out both trees and compacting them") {
+          std::size_t slabsBefore[2] = {matching.slabCount(),
+                                        rest.slabCount()};
+          std::vector<int> kept[2];
+          std::size_t visited[2] = {0, 0};
+          for (int key : keys) {
+            int side = key % modulus == 0 ? 0 : 1;
+            if (visited[side]++ % 8 == 0) {
+              kept[side].push_back(key);
+            } else {
+              REQUIRE((side == 0 ? matching : rest).deleteNode(key));
+            }
+          }
+          while (!matching.compactFor(std::chrono::microseconds(50))) {
+          }
+          while (!rest.compactFor(std::chrono::microseconds(50))) {
+          }
+          THEN("Both should shrink, as neither holds the other's nodes") {
+            requireValidTree(matching, kept[0]);
+            requireValidTree(rest, kept[1]);
+            REQUIRE(matching.slabCount() <= slabsBefore[0] / 8 + 2);
+            REQUIRE(rest.slabCount() <= slabsBefore[1] / 8 + 2);
+          }
+        }
+      }
+    }
+  }
+
+  GIVEN("A tree keeping its elements in a sorted array") {
+    RBTree<int> rb;
+    rb.setSmallLimit(16);
+    for (int i = 0; i < 10; ++i) {
+      rb.addNode(i);
+    }
+    WHEN("Partitioning it into even and odd elements") {
+      RBTree<int> even;
+      RBTree<int> odd;
+      even.setSmallLimit(8);
+      rb.partition([](int key) { return key % 2 == 0; }, even, odd);
+      THEN("Both trees should hold their elements") {
+        REQUIRE(rb.size() == 0);
+        REQUIRE(even.inOrder() == std::vector<int>{0, 2, 4, 6, 8});
+        REQUIRE(odd.inOrder() == std::vector<int>{1, 3, 5, 7, 9});
+      }
+      THEN("Only the tree without a small limit should use nodes") {
+        REQUIRE(even.slabCount() == 0);
+        REQUIRE(odd.slabCount() == 1);
+        requireValidTree(odd, {1, 3, 5, 7, 9});
+      }
+    }
+    THEN("Partitioning into itself should throw") {
+      RBTree<int> other;
+      auto pred = [](int key) { return key < 5; };
+      REQUIRE_THROWS(rb.partition(pred, rb, other));
+      REQUIRE_THROWS(rb.partition(pred, other, other));
+      REQUIRE(rb.size() == 10);
+    }
+  }
+}
+
+SCENARIO("Comparing trees") {
+  GIVEN("Two trees holding 0 - 999, inserted in different orders") {
+    RBTree<int> ascending;
+    RBTree<int> shuffled;
+    std::vector<int> keys(1000);
+    std::iota(keys.begin(), keys.end(), 0);
+    for (int key : keys) {
+      ascending.addNode(key);
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(5));
+    for (int key : keys) {
+      shuffled.addNode(key);
+    }
+    THEN("They should compare equal despite their different shapes") {
+      REQUIRE(ascending == shuffled);
+      REQUIRE_FALSE(ascending != shuffled);
+      REQUIRE(ascending.compare(shuffled) == 0);
+      REQUIRE(ascending.isSubsetOf(shuffled));
+      REQUIRE(shuffled.isSubsetOf(ascending));
+#if defined(__cpp_impl_three_way_comparison)
+      REQUIRE((ascending <=> shuffled) == std::weak_ordering::equivalent);
+#endif
+    }
+    WHEN("Replacing 500 by 1000 in one of them") {
+      shuffled.deleteNode(500);
+      shuffled.addNode(1000);
+      THEN("It should sort after the other, and neither contain the other") {
+        REQUIRE(ascending != shuffled);
+        REQUIRE(ascending.compare(shuffled) < 0);
+        REQUIRE(shuffled.compare(ascending) > 0);
+        REQUIRE_FALSE(ascending.isSubsetOf(shuffled));
+        REQUIRE_FALSE(shuffled.isSubsetOf(ascending));
+      }
+    }
+    WHEN("Deleting the largest element from one of them") {
+      shuffled.deleteNode(999);
+      THEN("The shorter tree should sort first and be a subset") {
+        REQUIRE(ascending != shuffled);
+        REQUIRE(shuffled.compare(ascending) < 0);
+        REQUIRE(ascending.compare(shuffled) > 0);
+        REQUIRE(shuffled.isSubsetOf(ascending));
+        REQUIRE_FALSE(ascending.isSubsetOf(shuffled));
+      }
+    }
+    WHEN("Comparing with a few of the elements kept in a sorted array") {
+      RBTree<int> few;
+      few.setSmallLimit(16);
+      for (int key : {3, 141, 592, 653}) {
+        few.addNode(key);
+      }
+      THEN("They should be a subset only while all of them are present") {
+        REQUIRE(few.isSubsetOf(ascending));
+        REQUIRE(few.compare(ascending) > 0);
+        REQUIRE_FALSE(ascending.isSubsetOf(few));
+        few.addNode(-1);
+        REQUIRE_FALSE(few.isSubsetOf(ascending));
+        REQUIRE(few.compare(ascending) < 0);
+      }
+    }
+  }
+
+  GIVEN("Two empty trees, one keeping its elements in a sorted array") {
+    RBTree<int> nodes;
+    RBTree<int> array;
+    array.setSmallLimit(8);
+    THEN("They should be equal and subsets of each other") {
+      REQUIRE(nodes == array);
+      REQUIRE(nodes.compare(array) == 0);
+      REQUIRE(nodes.isSubsetOf(array));
+      REQUIRE(array.isSubsetOf(nodes));
+    }
+    WHEN("Adding the same elements to both") {
+      for (int key : {5, 1, 4}) {
+        nodes.addNode(key);
+        array.addNode(key);
+      }
+      THEN("They should still be equal") {
+        REQUIRE(nodes == array);
+        REQUIRE(array == nodes);
+        REQUIRE(array.isSubsetOf(nodes));
+        REQUIRE(nodes.compare(array) == 0);
+      }
+    }
+  }
+}
+
+namespace {
+using HashedTree = RBTree<int, NodeLayout::STANDARD, std::hash<int>>;
+
+template <typename Tree>
+std::vector<int> diffOf(Tree& mine, Tree& theirs) {
+  std::vector<int> out;
+  mine.diff(theirs, std::back_inserter(out));
+  return out;
+}
+
+std::vector<int> symmetricDifference(const std::set<int>& a,
+                                     const std::set<int>& b) {
+  std::vector<int> out;
+  std::set_symmetric_difference(a.begin(), a.end(), b.begin(), b.end(),
+                                std::back_inserter(out));
+  return out;
+}
+
+struct PayloadHash {
+  std::size_t operator()(const Payload& payload) const {
+    return std::hash<int>()(payload.key) * 31 +
+           std::hash<std::string>()(payload.data);
+  }
+};
+}  // namespace
+
+SCENARIO("Finding the differences between two trees") {
+  GIVEN("Two replicas of 0 - 1999 built in different orders") {
+    HashedTree a;
+    HashedTree b;
+    std::set<int> inA;
+    std::vector<int> keys(2000);
+    std::iota(keys.begin(), keys.end(), 0);
+    for (int key : keys) {
+      a.addNode(key);
+      inA.insert(key);
+    }
+    std::mt19937 gen(11);
+    std::shuffle(keys.begin(), keys.end(), gen);
+    for (int key : keys) {
+      b.addNode(key);
+    }
+    std::set<int> inB = inA;
+    THEN("diff() should find nothing either way") {
+      REQUIRE(diffOf(a, b).empty());
+      REQUIRE(diffOf(b, a).empty());
+    }
+    WHEN("Changing the replicas apart with random operations") {
+      std::uniform_int_distribution<int> anyKey(-100, 2999);
+      std::uniform_int_distribution<int> anyOp(0, 6);
+      THEN("diff() should find exactly the elements in only one of them") {
+        for (int round = 0; round < 400; ++round) {
+          bool first = gen() % 2 == 0;
+          HashedTree& tree = first ? a : b;
+          std::set<int>& mirror = first ? inA : inB;
+          int key = anyKey(gen);
+          int other = anyKey(gen);
+          switch (anyOp(gen)) {
+            case 0:
+              REQUIRE(tree.addNode(key) == mirror.insert(key).second);
+              break;
+            case 1:
+              REQUIRE(tree.deleteNode(key) == (mirror.erase(key) == 1));
+              break;
+            case 2:
+              if (tree.rekey(key, other)) {
+                mirror.erase(key);
+                mirror.insert(other);
+              }
+              break;
+            case 3:
+              tree.eraseRange(key, key + 20);
+              mirror.erase(mirror.lower_bound(key),
+                           mirror.lower_bound(key + 20));
+              break;
+            case 4:
+              if (auto handle = tree.extract(key)) {
+                handle.value() = other;
+                mirror.erase(key);
+                if (tree.insert(std::move(handle))) {
+                  mirror.insert(other);
+                }
+              }
+              break;
+            case 5:
+              tree.eraseIf(
+                  [&](int element) { return element % 97 == key % 97; });
+              for (auto it = mirror.begin(); it != mirror.end();) {
+                it = *it % 97 == key % 97 ? mirror.erase(it) : std::next(it);
+              }
+              break;
+            default:
+              tree.relayout();
+              tree.compactStep(100);
+              break;
+          }
+          REQUIRE(diffOf(a, b) == symmetricDifference(inA, inB));
+          REQUIRE(diffOf(b, a) == symmetricDifference(inA, inB));
+        }
+      }
+    }
+    WHEN("Splitting one replica by partition() and merging it back") {
+      HashedTree evens;
+      HashedTree odds;
+      a.partition([](int key) { return key % 2 == 0; }, evens, odds);
+      THEN("Each part should differ from the other replica by the other part") {
+        std::vector<int> oddKeys = odds.inOrder();
+        REQUIRE(diffOf(evens, b) == oddKeys);
+        evens.merge(odds);
+        REQUIRE(diffOf(evens, b).empty());
+        REQUIRE(diffOf(b, evens).empty());
+      }
+    }
+    WHEN("Comparing with a few elements kept in a sorted array") {
+      HashedTree few;
+      few.setSmallLimit(16);
+      for (int key : {-5, 7, 1999, 2000}) {
+        few.addNode(key);
+      }
+      THEN("diff() should work in both directions") {
+        std::set<int> inFew{-5, 7, 1999, 2000};
+        REQUIRE(diffOf(b, few) == symmetricDifference(inB, inFew));
+        REQUIRE(diffOf(few, b) == symmetricDifference(inB, inFew));
+      }
+    }
+  }
+
+  GIVEN("Two equal trees of compact nodes with payloads") {
+    RBTree<Payload, NodeLayout::COMPACT, PayloadHash> a;
+    RBTree<Payload, NodeLayout::COMPACT, PayloadHash> b;
+    for (int i = 0; i < 500; ++i) {
+      a.emplace(i, "v1");
+      b.emplace(499 - i, "v1");
+    }
+    WHEN("Updating the payload of two elements in one of them") {
+      for (int key : {42, 300}) {
+        REQUIRE(a.modify(Payload(key, ""),
+                         [](Payload& payload) { payload.data = "v2"; }));
+      }
+      std::vector<Payload> changed;
+      a.diff(b, std::back_inserter(changed));
+      THEN("diff() should report that tree's versions of both") {
+        REQUIRE(changed.size() == 2);
+        REQUIRE(changed[0].key == 42);
+        REQUIRE(changed[1].key == 300);
+        REQUIRE(changed[0].data == "v2");
+        REQUIRE(changed[1].data == "v2");
+      }
+    }
+  }
+}